@@ -1,11 +1,7 @@
 #include "types.hpp"
 #include "chess.hpp"
+#include "nnue.hpp"
 Board::Board(std::string fen) {
-    initializeLookupTables();
-    stateHistory.reserve(MAX_PLY);
-    hashHistory.reserve(512);
-    pawnKeyHistory.reserve(512);
-
     sideToMove = White;
     enPassantSquare = NO_SQ;
     castlingRights = wk | wq | bk | bq;
@@ -34,6 +30,8 @@ void Board::applyFen(const std::string &fen) {
     }
 
     pawnKey = 0ULL;
+    psqtScore = 0;
+    phase = 0;
 
     const std::vector<std::string> params = splitInput(fen);
 
@@ -91,19 +89,27 @@ void Board::applyFen(const std::string &fen) {
 
     hashKey = zobristHash();
 
-    hashHistory.clear();
-    pawnKeyHistory.clear();
     stateHistory.clear();
-
-    hashHistory.push_back(hashKey);
-    pawnKeyHistory.push_back(pawnKey);
 }
 
 
 // Do a move
+template <bool updateNNUE>
+void Board::makeMove(Move move) {
+    if (sideToMove == White)
+        makeMove<White, updateNNUE>(move);
+    else
+        makeMove<Black, updateNNUE>(move);
+}
+
+template <Color c, bool updateNNUE>
 void Board::makeMove(Move move) {
+    assert(sideToMove == c);
+    constexpr Color them = ~c;
+    constexpr Piece rook = makePiece(ROOK, c);
+
     PieceType pt = piece(move);
-    Piece p = makePiece(pt, sideToMove);
+    Piece p = makePiece(pt, c);
     Square from_sq = from(move);
     Square to_sq = to(move);
     Piece capture = board[to_sq];
@@ -118,16 +124,16 @@ void Board::makeMove(Move move) {
     // STORE STATE HISTORY
     // *****************************
 
-    hashHistory.emplace_back(hashKey);
-    stateHistory.emplace_back(State(enPassantSquare, castlingRights, halfMoveClock, capture));
-    pawnKeyHistory.emplace_back(pawnKey);
+    stateHistory.push() = {hashKey, pawnKey, enPassantSquare, castlingRights, halfMoveClock, capture};
 
+    if constexpr (updateNNUE)
+        nnue->push();
 
     halfMoveClock++;
     fullMoveNumber++;
 
     bool ep = to_sq == enPassantSquare;
-    const bool isCastling = pt == KING && type_of_piece(capture) == ROOK && colorOf(from_sq) == colorOf(to_sq);
+    const bool isCastling = pt == KING && capture == rook;
 
     // *****************************
     // UPDATE HASH
@@ -141,7 +147,6 @@ void Board::makeMove(Move move) {
 
 
     if (isCastling) {
-        Piece rook = sideToMove == White ? WhiteRook : BlackRook;
         Square rookSQ = file_rank_square(to_sq > from_sq ? FILE_F : FILE_D, square_rank(from_sq));
 
         assert(type_of_piece(pieceAtB(to_sq)) == ROOK);
@@ -150,16 +155,17 @@ void Board::makeMove(Move move) {
     }
 
     if (pt == KING) {
-        removeCastlingRightsAll(sideToMove);
+        removeCastlingRightsAll(c);
     } else if (pt == ROOK) {
         removeCastlingRightsRook(from_sq);
     } else if (pt == PAWN) {
         halfMoveClock = 0;
         if (ep) {
-            hashKey ^= updateKeyPiece(makePiece(PAWN, ~sideToMove), Square(to_sq ^ 8));
+            hashKey ^= updateKeyPiece(makePiece(PAWN, them), Square(to_sq ^ 8));
+            pawnKey ^= updateKeyPiece(makePiece(PAWN, them), Square(to_sq ^ 8));
         } else if (std::abs(from_sq - to_sq) == 16) {
-            U64 epMask = PawnAttacks(Square(to_sq ^ 8), sideToMove);
-            if (epMask & pieces(PAWN, ~sideToMove)) {
+            U64 epMask = PawnAttacks(Square(to_sq ^ 8), c);
+            if (epMask & pieces(PAWN, them)) {
                 enPassantSquare = Square(to_sq ^ 8);
                 hashKey ^= updateKeyEnPassant(enPassantSquare);
 
@@ -178,13 +184,11 @@ void Board::makeMove(Move move) {
     if (promoted(move)) {
         halfMoveClock = 0;
 
-        hashKey ^= updateKeyPiece(makePiece(PAWN, sideToMove), from_sq);
+        hashKey ^= updateKeyPiece(makePiece(PAWN, c), from_sq);
         hashKey ^= updateKeyPiece(p, to_sq);
 
-        if (pt == PAWN) {
-            pawnKey ^= updateKeyPiece(makePiece(PAWN, sideToMove), from_sq);
-            pawnKey ^= updateKeyPiece(p, to_sq);
-        }
+        // the promoting pawn leaves the pawn structure
+        pawnKey ^= updateKeyPiece(makePiece(PAWN, c), from_sq);
     } else {
         hashKey ^= updateKeyPiece(p, from_sq);
         hashKey ^= updateKeyPiece(p, to_sq);
@@ -202,23 +206,19 @@ void Board::makeMove(Move move) {
     // *****************************
 
     if (isCastling) {
-        const Piece rook = sideToMove == White ? WhiteRook : BlackRook;
         Square rookToSq = file_rank_square(to_sq > from_sq ? FILE_F : FILE_D, square_rank(from_sq));
         Square kingToSq = file_rank_square(to_sq > from_sq ? FILE_G : FILE_C, square_rank(from_sq));
 
-        
-            removePiece(p, from_sq);
-            removePiece(rook, to_sq);
+        removePiece<updateNNUE>(p, from_sq);
+        removePiece<updateNNUE>(rook, to_sq);
 
-            placePiece(p, kingToSq);
-            placePiece(rook, rookToSq);
-
-    
+        placePiece<updateNNUE>(p, kingToSq);
+        placePiece<updateNNUE>(rook, rookToSq);
 
     } else if (pt == PAWN && ep) {
         assert(pieceAtB(Square(to_sq ^ 8)) != None);
 
-        removePiece(makePiece(PAWN, ~sideToMove), Square(to_sq ^ 8));
+        removePiece<updateNNUE>(makePiece(PAWN, them), Square(to_sq ^ 8));
 
     } else if (capture != None && !isCastling) {
         assert(pieceAtB(to_sq) != None);
@@ -227,37 +227,46 @@ void Board::makeMove(Move move) {
             pawnKey ^= updateKeyPiece(capture, to_sq);
         }
 
-        removePiece(capture, to_sq);
+        removePiece<updateNNUE>(capture, to_sq);
     }
 
     if (promoted(move)) {
         assert(pieceAtB(to_sq) == None);
 
-        removePiece(makePiece(PAWN, sideToMove), from_sq);
-        placePiece(p, to_sq);
+        removePiece<updateNNUE>(makePiece(PAWN, c), from_sq);
+        placePiece<updateNNUE>(p, to_sq);
 
     } else if (!isCastling) {
         assert(pieceAtB(to_sq) == None);
 
-        movePiece(p, from_sq, to_sq);
+        movePiece<updateNNUE>(p, from_sq, to_sq);
     }
 
-    sideToMove = ~sideToMove;
+    sideToMove = them;
 }
 
 
 // reset a move
+template <bool updateNNUE>
 void Board::unmakeMove(Move move) {
-    const State restore = stateHistory.back();
-    stateHistory.pop_back();
+    if (sideToMove == Black)
+        unmakeMove<White, updateNNUE>(move);
+    else
+        unmakeMove<Black, updateNNUE>(move);
+}
 
-    hashKey = hashHistory.back();
-    hashHistory.pop_back();
-    pawnKey = pawnKeyHistory.back();
-    pawnKeyHistory.pop_back();
+template <Color c, bool updateNNUE>
+void Board::unmakeMove(Move move) {
+    assert(sideToMove == ~c);
+    constexpr Piece rook = makePiece(ROOK, c);
+
+    const State &restore = stateHistory.pop();
 
-  
+    if constexpr (updateNNUE)
+        nnue->pop();
 
+    hashKey = restore.hashKey;
+    pawnKey = restore.pawnKey;
     enPassantSquare = restore.enPassant;
     castlingRights = restore.castling;
     halfMoveClock = restore.halfMove;
@@ -269,15 +278,14 @@ void Board::unmakeMove(Move move) {
     Square to_sq = to(move);
     bool promotion = promoted(move);
 
-    sideToMove = ~sideToMove;
+    sideToMove = c;
     PieceType pt = piece(move);
-    Piece p = makePiece(pt, sideToMove);
+    Piece p = makePiece(pt, c);
 
-    const bool isCastling = (p == WhiteKing && capture == WhiteRook) || (p == BlackKing && capture == BlackRook);
+    const bool isCastling = pt == KING && capture == rook;
 
     if (isCastling) {
         Square rookToSq = to_sq;
-        Piece rook = sideToMove == White ? WhiteRook : BlackRook;
         Square rookFromSq = file_rank_square(to_sq > from_sq ? FILE_F : FILE_D, square_rank(from_sq));
         to_sq = file_rank_square(to_sq > from_sq ? FILE_G : FILE_C, square_rank(from_sq));
 
@@ -289,7 +297,7 @@ void Board::unmakeMove(Move move) {
         placePiece(rook, rookToSq);
     } else if (promotion) {
         removePiece(p, to_sq);
-        placePiece(makePiece(PAWN, sideToMove), from_sq);
+        placePiece(makePiece(PAWN, c), from_sq);
         if (capture != None)
             placePiece(capture, to_sq);
         return;
@@ -298,16 +306,21 @@ void Board::unmakeMove(Move move) {
     }
 
     if (to_sq == enPassantSquare && pt == PAWN) {
-        int8_t offset = sideToMove == White ? -8 : 8;
-        placePiece(makePiece(PAWN, ~sideToMove), Square(enPassantSquare + offset));
+        constexpr int8_t offset = c == White ? -8 : 8;
+        placePiece(makePiece(PAWN, ~c), Square(enPassantSquare + offset));
     } else if (capture != None && !isCastling) {
 
         placePiece(capture, to_sq);
     }
 }
 
+template <bool updateNNUE>
 void Board::makeNullMove() {
-    stateHistory.emplace_back(State(enPassantSquare, castlingRights, halfMoveClock, None));
+    stateHistory.push() = {hashKey, pawnKey, enPassantSquare, castlingRights, halfMoveClock, None};
+
+    if constexpr (updateNNUE)
+        nnue->push();
+
     sideToMove = ~sideToMove;
 
     hashKey ^= updateKeySideToMove();
@@ -318,18 +331,18 @@ void Board::makeNullMove() {
     fullMoveNumber++;
 }
 
+template <bool updateNNUE>
 void Board::unmakeNullMove() {
-    const State restore = stateHistory.back();
-    stateHistory.pop_back();
+    const State &restore = stateHistory.pop();
+
+    if constexpr (updateNNUE)
+        nnue->pop();
 
+    hashKey = restore.hashKey;
     enPassantSquare = restore.enPassant;
     castlingRights = restore.castling;
     halfMoveClock = restore.halfMove;
 
-    hashKey ^= updateKeySideToMove();
-    if (enPassantSquare != NO_SQ)
-        hashKey ^= updateKeyEnPassant(enPassantSquare);
-
     fullMoveNumber--;
     sideToMove = ~sideToMove;
 }
@@ -337,11 +350,15 @@ void Board::unmakeNullMove() {
 void Board::removePiece(Piece piece, Square sq) {
     piecesBB[piece] &= ~(1ULL << sq);
     board[sq] = None;
+    psqtScore -= Eval::PSQT[piece][sq];
+    phase -= Eval::PHASE[piece];
 }
 
 void Board::placePiece(Piece piece, Square sq) {
     piecesBB[piece] |= (1ULL << sq);
     board[sq] = piece;
+    psqtScore += Eval::PSQT[piece][sq];
+    phase += Eval::PHASE[piece];
 }
 
 void Board::movePiece(Piece piece, Square fromSq, Square toSq) {
@@ -349,12 +366,124 @@ void Board::movePiece(Piece piece, Square fromSq, Square toSq) {
     piecesBB[piece] |= (1ULL << toSq);
     board[fromSq] = None;
     board[toSq] = piece;
+    psqtScore += Eval::PSQT[piece][toSq] - Eval::PSQT[piece][fromSq];
+}
+template <bool updateNNUE>
+void Board::removePiece(Piece piece, Square sq) {
+    removePiece(piece, sq);
+    if constexpr (updateNNUE)
+        nnue->remove(piece, sq);
+}
+
+template <bool updateNNUE>
+void Board::placePiece(Piece piece, Square sq) {
+    placePiece(piece, sq);
+    if constexpr (updateNNUE)
+        nnue->add(piece, sq);
+}
+
+template <bool updateNNUE>
+void Board::movePiece(Piece piece, Square fromSq, Square toSq) {
+    movePiece(piece, fromSq, toSq);
+    if constexpr (updateNNUE)
+        nnue->move(piece, fromSq, toSq);
+}
+
+void Board::refresh(NNUE::Net &net) {
+    nnue = &net;
+    nnue->reset();
+}
+
+template void Board::makeMove<false>(Move move);
+template void Board::makeMove<true>(Move move);
+template void Board::unmakeMove<false>(Move move);
+template void Board::unmakeMove<true>(Move move);
+template void Board::makeMove<White, false>(Move move);
+template void Board::makeMove<White, true>(Move move);
+template void Board::makeMove<Black, false>(Move move);
+template void Board::makeMove<Black, true>(Move move);
+template void Board::unmakeMove<White, false>(Move move);
+template void Board::unmakeMove<White, true>(Move move);
+template void Board::unmakeMove<Black, false>(Move move);
+template void Board::unmakeMove<Black, true>(Move move);
+template void Board::makeNullMove<false>();
+template void Board::makeNullMove<true>();
+template void Board::unmakeNullMove<false>();
+template void Board::unmakeNullMove<true>();
+
+CheckInfo Board::checkInfo() const {
+    CheckInfo ci;
+    const Color us = sideToMove;
+    const Square ksq = KingSQ(~us);
+    const U64 occ = All();
+
+    ci.enemyKing = ksq;
+    ci.checkSquares[PAWN] = PawnAttacks(ksq, ~us);
+    ci.checkSquares[KNIGHT] = KnightAttacks(ksq);
+    ci.checkSquares[BISHOP] = BishopAttacks(ksq, occ);
+    ci.checkSquares[ROOK] = RookAttacks(ksq, occ);
+    ci.checkSquares[QUEEN] = ci.checkSquares[BISHOP] | ci.checkSquares[ROOK];
+    ci.checkSquares[KING] = 0;
+
+    // Our sliders that would see the king through exactly one of our own pieces
+    U64 snipers = ((pieces(BISHOP, us) | pieces(QUEEN, us)) & BishopAttacks(ksq, 0)) |
+                  ((pieces(ROOK, us) | pieces(QUEEN, us)) & RookAttacks(ksq, 0));
+
+    while (snipers) {
+        const Square sniper = poplsb(snipers);
+        const U64 between = SQUARES_BETWEEN_BB[ksq][sniper] & occ;
+
+        if (popcount(between) == 1 && (between & Us(us)))
+            ci.discoverers |= between;
+    }
+
+    return ci;
+}
+
+bool Board::givesCheck(const CheckInfo &ci, Move move) const {
+    const Color us = sideToMove;
+    const Square from_sq = from(move);
+    const Square to_sq = to(move);
+    const PieceType moved = pieceTypeAtB(from_sq);
+    const U64 kingBB = 1ULL << ci.enemyKing;
+
+    // Castling is encoded as the king taking its own rook, only the rook can give check
+    if (moved == KING && pieceAtB(to_sq) != None && colorOf(to_sq) == us) {
+        const Square kingTo = file_rank_square(to_sq > from_sq ? FILE_G : FILE_C, square_rank(from_sq));
+        const Square rookTo = file_rank_square(to_sq > from_sq ? FILE_F : FILE_D, square_rank(from_sq));
+        const U64 occ = (All() ^ (1ULL << from_sq) ^ (1ULL << to_sq)) | (1ULL << kingTo) | (1ULL << rookTo);
+        return RookAttacks(rookTo, occ) & kingBB;
+    }
+
+    // Promotions and en passant change the occupancy in ways the check squares
+    // do not cover, work those out on the board after the move
+    const bool ep = moved == PAWN && to_sq == enPassantSquare;
+    if (promoted(move) || ep) {
+        U64 occ = (All() ^ (1ULL << from_sq)) | (1ULL << to_sq);
+        if (ep)
+            occ ^= 1ULL << (to_sq ^ 8);
+
+        const U64 bishops = pieces(BISHOP, us) | pieces(QUEEN, us);
+        const U64 rooks = pieces(ROOK, us) | pieces(QUEEN, us);
+        if ((BishopAttacks(ci.enemyKing, occ) & bishops) || (RookAttacks(ci.enemyKing, occ) & rooks))
+            return true;
+
+        switch (promoted(move) ? piece(move) : PAWN) {
+        case PAWN:   return PawnAttacks(to_sq, us) & kingBB;
+        case KNIGHT: return KnightAttacks(to_sq) & kingBB;
+        case BISHOP: return BishopAttacks(to_sq, occ) & kingBB;
+        case ROOK:   return RookAttacks(to_sq, occ) & kingBB;
+        default:     return (BishopAttacks(to_sq, occ) | RookAttacks(to_sq, occ)) & kingBB;
+        }
+    }
+
+    // Direct check
+    if (ci.checkSquares[moved] & (1ULL << to_sq))
+        return true;
+
+    // Discovered check, unless the piece stays on the line it was blocking
+    if (ci.discoverers & (1ULL << from_sq))
+        return !(LINE_BB[from_sq][ci.enemyKing] & (1ULL << to_sq));
+
+    return false;
 }
-bool givesCheck(const Board&board,Move move) {
-    // Make a copy of the board and apply the move
-    Board temp = const_cast<Board&>(board);
-    temp.makeMove(move);
-    // Check if the opponent's king is in check after the move
-    Square enemyKingSq = temp.KingSQ(temp.sideToMove);
-    return temp.isSquareAttacked(~temp.sideToMove, enemyKingSq);
- }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include <cassert>
 #include <chrono>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <unordered_map>
@@ -22,6 +23,17 @@ namespace NNUE
    struct Net;
 }
 
+namespace Eval
+{
+   // Material + piece-square value of every piece on every square, packed as
+   // (mg, eg) from White's point of view. Defined by the evaluator and
+   // accumulated incrementally by the Board.
+   extern const std::array<std::array<int32_t, 64>, 12> PSQT;
+
+   // Game phase contribution of every piece
+   extern const std::array<uint8_t, 12> PHASE;
+}
+
 using namespace Chess_Lookup::Fancy;
 
 namespace Chess
@@ -480,6 +492,68 @@ static constexpr U64 castlingKey[16] = {0,
    static constexpr U64 MASK_RANK[8] = {0xff, 0xff00, 0xff0000, 0xff000000,
                                         0xff00000000, 0xff0000000000, 0xff000000000000, 0xff00000000000000};
 
+   // *******************
+   // Between / line tables
+   // *******************
+
+   /// @brief squares strictly between sq1 and sq2 if they share a rank, file or diagonal, otherwise 0
+   /// @param sq1
+   /// @param sq2
+   /// @return
+   constexpr U64 squaresBetween(int sq1, int sq2)
+   {
+      const int f1 = sq1 & 7, r1 = sq1 >> 3;
+      const int f2 = sq2 & 7, r2 = sq2 >> 3;
+      const int df = (f2 > f1) - (f2 < f1);
+      const int dr = (r2 > r1) - (r2 < r1);
+
+      if (sq1 == sq2 || !(f1 == f2 || r1 == r2 || f2 - f1 == r2 - r1 || f2 - f1 == r1 - r2))
+         return 0ULL;
+
+      U64 bb = 0ULL;
+      for (int f = f1 + df, r = r1 + dr; f != f2 || r != r2; f += df, r += dr)
+         bb |= 1ULL << (r * 8 + f);
+      return bb;
+   }
+
+   /// @brief the full edge-to-edge line through sq1 and sq2 (both included), 0 if they are not aligned
+   /// @param sq1
+   /// @param sq2
+   /// @return
+   constexpr U64 squaresLine(int sq1, int sq2)
+   {
+      const int f1 = sq1 & 7, r1 = sq1 >> 3;
+      const int f2 = sq2 & 7, r2 = sq2 >> 3;
+      const int df = (f2 > f1) - (f2 < f1);
+      const int dr = (r2 > r1) - (r2 < r1);
+
+      if (sq1 == sq2 || !(f1 == f2 || r1 == r2 || f2 - f1 == r2 - r1 || f2 - f1 == r1 - r2))
+         return 0ULL;
+
+      U64 bb = 1ULL << sq1;
+      for (int f = f1 + df, r = r1 + dr; f >= 0 && f < 8 && r >= 0 && r < 8; f += df, r += dr)
+         bb |= 1ULL << (r * 8 + f);
+      for (int f = f1 - df, r = r1 - dr; f >= 0 && f < 8 && r >= 0 && r < 8; f -= df, r -= dr)
+         bb |= 1ULL << (r * 8 + f);
+      return bb;
+   }
+
+   template <U64 (*Fn)(int, int)>
+   constexpr std::array<std::array<U64, MAX_SQ>, MAX_SQ> makeSquarePairTable()
+   {
+      std::array<std::array<U64, MAX_SQ>, MAX_SQ> table{};
+      for (int sq1 = 0; sq1 < MAX_SQ; sq1++)
+         for (int sq2 = 0; sq2 < MAX_SQ; sq2++)
+            table[sq1][sq2] = Fn(sq1, sq2);
+      return table;
+   }
+
+   /// @brief squares between two aligned squares, shared by all boards
+   inline constexpr auto SQUARES_BETWEEN_BB = makeSquarePairTable<squaresBetween>();
+
+   /// @brief full line through two aligned squares, shared by all boards
+   inline constexpr auto LINE_BB = makeSquarePairTable<squaresLine>();
+
    static std::unordered_map<Piece, char> pieceToChar({{WhitePawn, 'P'},
                                                        {WhiteKnight, 'N'},
                                                        {WhiteBishop, 'B'},
@@ -542,16 +616,84 @@ static constexpr U64 castlingKey[16] = {0,
       return Move((uint16_t)source | (uint16_t)target << 6 | (uint16_t)piece << 12 | (uint16_t)promoted << 15);
    }
 
+   /// @brief everything makeMove cannot recompute when undoing a move
    struct State
    {
+      U64 hashKey{};
+      U64 pawnKey{};
       Square enPassant{};
       uint8_t castling{};
       uint8_t halfMove{};
       Piece capturedPiece = None;
-      State(Square enpassantCopy = {}, uint8_t castlingRightsCopy = {}, uint8_t halfMoveCopy = {},
-            Piece capturedPieceCopy = None)
-          : enPassant(enpassantCopy), castling(castlingRightsCopy), halfMove(halfMoveCopy),
-            capturedPiece(capturedPieceCopy) {}
+   };
+
+   /// @brief what it takes for the side to move to check the enemy king in one move
+   struct CheckInfo
+   {
+      // squares from which a piece of each type attacks the enemy king
+      U64 checkSquares[6]{};
+      // our pieces that uncover a slider on the enemy king by moving away
+      U64 discoverers{};
+      Square enemyKing{NO_SQ};
+   };
+
+   // records reserved up front, enough for a long game plus a full search line
+   static constexpr int INITIAL_HISTORY = 512 + MAX_PLY;
+
+   /// @brief undo stack, one record per played (null)move.
+   /// The records live on the heap so Board stays small, the buffer only
+   /// grows (off the hot path) when a game outlasts the reserved capacity.
+   /// Copying only touches the live records.
+   struct StateStack
+   {
+      std::unique_ptr<State[]> list;
+      int size = 0;
+      int capacity = 0;
+
+      StateStack() = default;
+
+      StateStack(const StateStack &other) { *this = other; }
+
+      StateStack(StateStack &&other) noexcept = default;
+
+      StateStack &operator=(const StateStack &other)
+      {
+         if (this == &other)
+            return *this;
+         if (capacity < other.size)
+         {
+            capacity = std::max(other.capacity, INITIAL_HISTORY);
+            list = std::make_unique<State[]>(capacity);
+         }
+         size = other.size;
+         std::copy_n(other.list.get(), size, list.get());
+         return *this;
+      }
+
+      StateStack &operator=(StateStack &&other) noexcept = default;
+
+      inline State &push()
+      {
+         if (size == capacity) [[unlikely]]
+            grow();
+         return list[size++];
+      }
+
+      inline const State &pop() { return list[--size]; }
+
+      inline void clear() { size = 0; }
+
+      inline const State &operator[](int i) const { return list[i]; }
+
+   private:
+      void grow()
+      {
+         const int newCapacity = std::max(capacity * 2, INITIAL_HISTORY);
+         auto grown = std::make_unique<State[]>(newCapacity);
+         std::copy_n(list.get(), size, grown.get());
+         list = std::move(grown);
+         capacity = newCapacity;
+      }
    };
 
    struct ExtMove
@@ -769,7 +911,7 @@ static constexpr U64 castlingKey[16] = {0,
    /// @param type
    /// @param c
    /// @return
-   inline Piece makePiece(PieceType type, Color c)
+   constexpr Piece makePiece(PieceType type, Color c)
    {
       if (type == NONETYPE)
          return None;
@@ -801,6 +943,44 @@ static constexpr U64 castlingKey[16] = {0,
    class Board
    {
    public:
+      // Hot state first: everything movegen, make/unmake and eval touch
+      // on every node lives in the leading cache lines.
+
+      U64 piecesBB[12] = {};
+      Piece board[MAX_SQ];
+
+      // current hashkey
+      U64 hashKey;
+      U64 pawnKey;
+
+      // incrementally updated material + piece-square score (packed mg/eg)
+      // and game phase, maintained by placePiece/removePiece/movePiece
+      int32_t psqtScore;
+      int32_t phase;
+
+      // Occupation piecesBB
+      U64 occEnemy;
+      U64 occUs;
+      U64 occAll;
+      U64 enemyEmptyBB;
+
+      // all bits set if we are not in check
+      // otherwise the path between the king and the checker
+      // in case of knights giving check only the knight square
+      // is checked
+      U64 checkMask = DEFAULT_CHECKMASK;
+
+      // the path between horizontal/vertical pinners and
+      // the pinned is set
+      U64 pinHV;
+
+      // the path between diagonal pinners and
+      // the pinned is set
+      U64 pinD;
+
+      // all squares that are seen by an enemy piece
+      U64 seen;
+
       Color sideToMove;
 
       // NO_SQ when enpassant is not possible
@@ -818,56 +998,24 @@ static constexpr U64 castlingKey[16] = {0,
       // halfmoves start at 0
       uint8_t halfMoveClock;
 
-      // full moves start at 1
-      uint16_t fullMoveNumber;
-
-      // current hashkey
-      U64 hashKey;
-      U64 pawnKey;
-
-      U64 piecesBB[12] = {};
-      Piece board[MAX_SQ];
-
       // keeps track on how many checks there currently are
       // 2 = only king moves are valid
       // 1 = king move, block/capture
       uint8_t doubleCheck;
 
-      // the path between horizontal/vertical pinners and
-      // the pinned is set
-      U64 pinHV;
-
-      // the path between diagonal pinners and
-      // the pinned is set
-      U64 pinD;
-
-      // all bits set if we are not in check
-      // otherwise the path between the king and the checker
-      // in case of knights giving check only the knight square
-      // is checked
-      U64 checkMask = DEFAULT_CHECKMASK;
-
-      // all squares that are seen by an enemy piece
-      U64 seen;
-
-      // Occupation piecesBB
-      U64 occEnemy;
-      U64 occUs;
-      U64 occAll;
-      U64 enemyEmptyBB;
-
-      U64 SQUARES_BETWEEN_BB[MAX_SQ][MAX_SQ];
+      // full moves start at 1
+      uint16_t fullMoveNumber;
 
    private:
-      // keeps track of previous hashes, used for
-      // repetition detection
-      std::vector<U64> hashHistory;
-      std::vector<U64> pawnKeyHistory;
+      // accumulator stack bound by refresh(), only touched by the updateNNUE paths
+      NNUE::Net *nnue = nullptr;
 
-      std::vector<State> stateHistory;
+      // state before every move played since the last fen,
+      // also used for repetition detection
+      StateStack stateHistory;
 
    public:
-      /// @brief constructor for the board, loads startpos and initializes SQUARES_BETWEEN_BB array
+      /// @brief constructor for the board, loads the given fen
       Board(std::string fen);
 
       /// @brief Finds what piece is on the square using bitboards (slow)
@@ -903,6 +1051,8 @@ static constexpr U64 castlingKey[16] = {0,
 
       Square KingSQ(Color c) const;
 
+      /// @brief binds the board to an accumulator stack and marks it for a full refresh
+      /// @param nnue
       void refresh(NNUE::Net &nnue);
 
       U64 Enemy(Color c) const;
@@ -939,21 +1089,57 @@ static constexpr U64 castlingKey[16] = {0,
       /// @return
       bool isSquareAttacked(Color c, Square sq) const;
 
-      U64 allAttackers(Square sq, U64 occupiedBB);
-      U64 attackersForSide(Color attackerColor, Square sq, U64 occupiedBB);
+      /// @brief all pieces of both colors attacking sq, given an occupancy
+      /// @param sq
+      /// @param occupiedBB
+      /// @return
+      U64 allAttackers(Square sq, U64 occupiedBB) const;
+
+      /// @brief all pieces of attackerColor attacking sq, given an occupancy
+      /// @param attackerColor
+      /// @param sq
+      /// @param occupiedBB
+      /// @return
+      U64 attackersForSide(Color attackerColor, Square sq, U64 occupiedBB) const;
+
+      /// @brief check squares and discovered check candidates of the side to move
+      /// @return
+      CheckInfo checkInfo() const;
+
+      /// @brief does the move check the enemy king, without playing it
+      /// @param ci checkInfo() of this position
+      /// @param move a legal move
+      /// @return
+      bool givesCheck(const CheckInfo &ci, Move move) const;
 
       /// @brief plays the move on the internal board
+      /// @tparam updateNNUE also record the changed pieces on the bound accumulator stack
       /// @param move
+      template <bool updateNNUE = false>
+      void makeMove(Move move);
+
+      /// @brief makeMove for a side to move known at compile time, used by the search
+      /// @tparam c must be sideToMove
+      template <Color c, bool updateNNUE>
       void makeMove(Move move);
 
       /// @brief unmake a move played on the internal board
+      /// @tparam updateNNUE must match the makeMove call
       /// @param move
+      template <bool updateNNUE = false>
+      void unmakeMove(Move move);
+
+      /// @brief unmakeMove for a side known at compile time
+      /// @tparam c the side that played the move, the opponent of sideToMove
+      template <Color c, bool updateNNUE>
       void unmakeMove(Move move);
 
       /// @brief make a nullmove
+      template <bool updateNNUE = false>
       void makeNullMove();
 
       /// @brief unmake a nullmove
+      template <bool updateNNUE = false>
       void unmakeNullMove();
 
       /// @brief Remove a Piece from the board
@@ -962,14 +1148,15 @@ static constexpr U64 castlingKey[16] = {0,
       void removePiece(Piece piece, Square sq);
 
       template <bool updateNNUE>
-      void removePiece(Piece piece, Square sq, Square kSQ_White, Square kSQ_Black);
+      void removePiece(Piece piece, Square sq);
 
       /// @brief Place a Piece on the board
       /// @param piece
       /// @param sq
       void placePiece(Piece piece, Square sq);
+
       template <bool updateNNUE>
-      void placePiece(Piece piece, Square sq, Square kSQ_White, Square kSQ_Black);
+      void placePiece(Piece piece, Square sq);
 
       /// @brief Move a piece on the board
       /// @param piece
@@ -978,7 +1165,7 @@ static constexpr U64 castlingKey[16] = {0,
       void movePiece(Piece piece, Square fromSq, Square toSq);
 
       template <bool updateNNUE>
-      void movePiece(Piece piece, Square fromSq, Square toSq, Square kSQ_White, Square kSQ_Black);
+      void movePiece(Piece piece, Square fromSq, Square toSq);
 
       U64 attacksByPiece(PieceType pt, Square sq, Color c) const;
 
@@ -991,9 +1178,6 @@ static constexpr U64 castlingKey[16] = {0,
       /// @return
       U64 zobristHash() const;
 
-      /// @brief initialize SQUARES_BETWEEN_BB array
-      void initializeLookupTables();
-
       // update the hash
 
       U64 updateKeyCastling() const;
@@ -1102,10 +1286,11 @@ static constexpr U64 castlingKey[16] = {0,
    {
       uint8_t c = 0;
 
-      for (int i = static_cast<int>(hashHistory.size()) - 2;
-           i >= 0 && i >= static_cast<int>(hashHistory.size()) - halfMoveClock - 1; i -= 2)
+      const int size = stateHistory.size;
+
+      for (int i = size - 2; i >= 0 && i >= size - halfMoveClock; i -= 2)
       {
-         if (hashHistory[i] == hashKey)
+         if (stateHistory[i].hashKey == hashKey)
             c++;
          if (c == draw)
             return true;
@@ -1151,12 +1336,12 @@ static constexpr U64 castlingKey[16] = {0,
       return false;
    }
 
-   inline U64 Board::allAttackers(Square sq, U64 occupiedBB)
+   inline U64 Board::allAttackers(Square sq, U64 occupiedBB) const
    {
       return attackersForSide(White, sq, occupiedBB) | attackersForSide(Black, sq, occupiedBB);
    }
 
-   inline U64 Board::attackersForSide(Color attackerColor, Square sq, U64 occupiedBB)
+   inline U64 Board::attackersForSide(Color attackerColor, Square sq, U64 occupiedBB) const
    {
       U64 attackingBishops = pieces(BISHOP, attackerColor);
       U64 attackingRooks = pieces(ROOK, attackerColor);
@@ -1255,25 +1440,6 @@ static constexpr U64 castlingKey[16] = {0,
       return hash ^ cast_hash ^ turn_hash ^ ep_hash;
    }
 
-   inline void Board::initializeLookupTables()
-   {
-      // initialize squares between table
-      U64 sqs;
-      for (Square sq1 = SQ_A1; sq1 <= SQ_H8; ++sq1)
-      {
-         for (Square sq2 = SQ_A1; sq2 <= SQ_H8; ++sq2)
-         {
-            sqs = (1ULL << sq1) | (1ULL << sq2);
-            if (sq1 == sq2)
-               SQUARES_BETWEEN_BB[sq1][sq2] = 0ull;
-            else if (square_file(sq1) == square_file(sq2) || square_rank(sq1) == square_rank(sq2))
-               SQUARES_BETWEEN_BB[sq1][sq2] = RookAttacks(sq1, sqs) & RookAttacks(sq2, sqs);
-            else if (diagonal_of(sq1) == diagonal_of(sq2) || anti_diagonal_of(sq1) == anti_diagonal_of(sq2))
-               SQUARES_BETWEEN_BB[sq1][sq2] = BishopAttacks(sq1, sqs) & BishopAttacks(sq2, sqs);
-         }
-      }
-   }
-
    inline U64 Board::updateKeyPiece(Piece piece, Square sq) const { return RANDOM_ARRAY[64 * hash_piece[piece] + sq]; }
 
    inline U64 Board::updateKeyEnPassant(Square sq) const { return RANDOM_ARRAY[772 + square_file(sq)]; }
@@ -1426,7 +1592,7 @@ namespace Movegen
          int8_t index = lsb(bishop_mask);
 
          // Now we add the path!
-         checks |= board.SQUARES_BETWEEN_BB[sq][index] | (1ULL << index);
+         checks |= SQUARES_BETWEEN_BB[sq][index] | (1ULL << index);
          board.doubleCheck++;
       }
       if (rook_mask)
@@ -1446,7 +1612,7 @@ namespace Movegen
          int8_t index = lsb(rook_mask);
 
          // Now we add the path!
-         checks |= board.SQUARES_BETWEEN_BB[sq][index] | (1ULL << index);
+         checks |= SQUARES_BETWEEN_BB[sq][index] | (1ULL << index);
          board.doubleCheck++;
       }
 
@@ -1475,7 +1641,7 @@ namespace Movegen
       while (rook_mask)
       {
          const Square index = poplsb(rook_mask);
-         const U64 possible_pin = (board.SQUARES_BETWEEN_BB[sq][index] | (1ULL << index));
+         const U64 possible_pin = (SQUARES_BETWEEN_BB[sq][index] | (1ULL << index));
          if (popcount(possible_pin & board.occUs) == 1)
             pinHV |= possible_pin;
       }
@@ -1492,7 +1658,7 @@ namespace Movegen
       while (bishop_mask)
       {
          const Square index = poplsb(bishop_mask);
-         const U64 possible_pin = (board.SQUARES_BETWEEN_BB[sq][index] | (1ULL << index));
+         const U64 possible_pin = (SQUARES_BETWEEN_BB[sq][index] | (1ULL << index));
          if (popcount(possible_pin & board.occUs) == 1)
             pinD |= possible_pin;
       }
@@ -2001,4 +2167,77 @@ namespace Movegen
       else
          legalmoves<Black, mt>(board, movelist);
    }
+
+   /********************
+    * Legality of a single move.
+    * Moves from the transposition table or the killer slots can come from
+    * another position, this checks them without generating the move list.
+    * Only the masks the moving piece needs are computed.
+    *******************/
+   template <Color c>
+   bool isLegal(Board &board, Move move)
+   {
+      if (move == NO_MOVE || move == NULL_MOVE)
+         return false;
+
+      const Square source = from(move);
+      const Square target = to(move);
+      const Piece moved = board.pieceAtB(source);
+      const PieceType type = promoted(move) ? PAWN : piece(move);
+
+      if (moved == None || board.colorOf(source) != c || type_of_piece(moved) != type)
+         return false;
+
+      const Square kSq = board.KingSQ(c);
+      board.occUs = board.Us<c>();
+      board.occEnemy = board.Us<~c>();
+      board.occAll = board.occUs | board.occEnemy;
+      board.enemyEmptyBB = ~board.occUs;
+      board.checkMask = DoCheckmask<c>(board, kSq);
+
+      if (type == KING)
+      {
+         board.seen = seenSquares<~c>(board);
+
+         const U64 moves = !board.castlingRights || board.checkMask != DEFAULT_CHECKMASK
+                               ? LegalKingMoves<ALL>(board, source)
+                               : LegalKingMovesCastling<c, ALL>(board, source);
+         return moves & (1ULL << target);
+      }
+
+      if (board.doubleCheck == 2)
+         return false;
+
+      board.pinHV = DoPinMaskRooks<c>(board, kSq);
+      board.pinD = DoPinMaskBishops<c>(board, kSq);
+
+      const U64 movableSquare = board.checkMask & board.enemyEmptyBB;
+      const U64 sourceBB = 1ULL << source;
+
+      switch (type)
+      {
+      case PAWN:
+      {
+         // Pawns have too many special cases to mirror, generate just their moves
+         Movelist pawnMoves;
+         LegalPawnMovesAll<c, ALL>(board, pawnMoves);
+         return pawnMoves.find(move) != -1;
+      }
+      case KNIGHT:
+         return !(sourceBB & (board.pinD | board.pinHV)) && (LegalKnightMoves(source, movableSquare) & (1ULL << target));
+      case BISHOP:
+         return !(sourceBB & board.pinHV) && (LegalBishopMoves(board, source, movableSquare) & (1ULL << target));
+      case ROOK:
+         return !(sourceBB & board.pinD) && (LegalRookMoves(board, source, movableSquare) & (1ULL << target));
+      case QUEEN:
+         return !(sourceBB & board.pinD & board.pinHV) && (LegalQueenMoves(board, source, movableSquare) & (1ULL << target));
+      default:
+         return false;
+      }
+   }
+
+   inline bool isLegal(Board &board, Move move)
+   {
+      return board.sideToMove == White ? isLegal<White>(board, move) : isLegal<Black>(board, move);
+   }
 } // namespace Movegen
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "chess.hpp"
+#include <array>
+
+// *******************
+// Evaluation masks
+// *******************
+
+// Everything here is built at compile time so pawn and king-zone terms
+// reduce to a few AND/popcount operations per side.
+
+using SquareMasks = std::array<std::array<U64, 64>, 2>;
+
+/// @brief every bit in b smeared towards the eighth rank
+constexpr U64 northFill(U64 b)
+{
+    b |= b << 8;
+    b |= b << 16;
+    b |= b << 32;
+    return b;
+}
+
+/// @brief every bit in b smeared towards the first rank
+constexpr U64 southFill(U64 b)
+{
+    b |= b >> 8;
+    b |= b >> 16;
+    b |= b >> 32;
+    return b;
+}
+
+/// @brief all squares of every file that has a bit set in b
+constexpr U64 fileFill(U64 b) { return northFill(b) | southFill(b); }
+
+/// @brief squares strictly in front of every bit in b, seen from color c
+constexpr U64 frontSpan(U64 b, Chess::Color c)
+{
+    return c == Chess::White ? northFill(b << 8) : southFill(b >> 8);
+}
+
+/// @brief neighbouring files, without the file itself
+inline constexpr std::array<U64, 8> ADJACENT_FILES = [] {
+    std::array<U64, 8> table{};
+    for (int f = 0; f < 8; f++)
+        table[f] = (f > 0 ? Chess::MASK_FILE[f - 1] : 0) | (f < 7 ? Chess::MASK_FILE[f + 1] : 0);
+    return table;
+}();
+
+/// @brief squares in front of sq on its own file
+inline constexpr SquareMasks FORWARD_FILE = [] {
+    SquareMasks table{};
+    for (int sq = 0; sq < 64; sq++)
+    {
+        table[Chess::White][sq] = frontSpan(1ULL << sq, Chess::White);
+        table[Chess::Black][sq] = frontSpan(1ULL << sq, Chess::Black);
+    }
+    return table;
+}();
+
+/// @brief the eight squares around sq
+inline constexpr std::array<U64, 64> KING_RING = [] {
+    std::array<U64, 64> table{};
+    for (int sq = 0; sq < 64; sq++)
+        for (int dr = -1; dr <= 1; dr++)
+            for (int df = -1; df <= 1; df++)
+            {
+                const int r = (sq >> 3) + dr, f = (sq & 7) + df;
+                if ((dr || df) && r >= 0 && r < 8 && f >= 0 && f < 8)
+                    table[sq] |= 1ULL << (r * 8 + f);
+            }
+    return table;
+}();
+
+/// @brief the two ranks in front of a king on sq, on its file and the adjacent ones
+inline constexpr SquareMasks SHIELD_ZONE = [] {
+    SquareMasks table{};
+    for (int c = 0; c < 2; c++)
+        for (int sq = 0; sq < 64; sq++)
+        {
+            const U64 files = Chess::MASK_FILE[sq & 7] | ADJACENT_FILES[sq & 7];
+            const int r = sq >> 3;
+            const int r1 = c == Chess::White ? r + 1 : r - 1;
+            const int r2 = c == Chess::White ? r + 2 : r - 2;
+            U64 ranks = 0;
+            if (r1 >= 0 && r1 < 8)
+                ranks |= Chess::MASK_RANK[r1];
+            if (r2 >= 0 && r2 < 8)
+                ranks |= Chess::MASK_RANK[r2];
+            table[c][sq] = files & ranks;
+        }
+    return table;
+}();
+
+/// @brief central squares on the fifth and sixth rank for White, second and third for Black
+inline constexpr std::array<U64, 2> OUTPOST_SQUARES = {0x00007E7E00000000ULL, 0x00000000007E7E00ULL};
+
+/// @brief squares whose rank and file add up to an odd number
+inline constexpr U64 LIGHT_SQUARES = 0x55AA55AA55AA55AAULL;
@@ -2,107 +2,51 @@
 #include "evaluate_features.hpp"
 #include "chess.hpp"
 #include "evaluate_pieces.hpp"
-// Convert from Chess::Square to 0-63 index for piece-square tables
-inline int squareToIndex(Square sq)
+namespace Eval
 {
-    return (7 - square_rank(sq)) * 8 + square_file(sq);
-}
-
-// Get flipped square for black pieces (to use same tables for both colors)
-inline int getFlippedSquare(Square sq)
-{
-    return squareToIndex(sq) ^ 56; // Flips vertically
-}
-
-// Calculate game phase based on remaining material (0.0 = opening, 1.0 = endgame)
-inline float getGamePhase(const Board &board)
-{
-    int remainingMaterial =
-        popcount(board.pieces(PAWN, White) | board.pieces(PAWN, Black)) * PAWN_VALUE +
-        popcount(board.pieces(KNIGHT, White) | board.pieces(KNIGHT, Black)) * KNIGHT_VALUE +
-        popcount(board.pieces(BISHOP, White) | board.pieces(BISHOP, Black)) * BISHOP_VALUE +
-        popcount(board.pieces(ROOK, White) | board.pieces(ROOK, Black)) * ROOK_VALUE +
-        popcount(board.pieces(QUEEN, White) | board.pieces(QUEEN, Black)) * QUEEN_VALUE;
-
-    float phase = 1.0f - std::min(1.0f, remainingMaterial / float(totalMaterial));
-    return phase;
-}
-
-int evaluate(const Board &board)
-{
-    int score = 0;
-    float endgameWeight = getGamePhase(board);
-
-    // Material counting using bitboards for efficiency
-    for (PieceType pt = PAWN; pt <= KING; ++pt)
+    // Tables are laid out rank 8 first, so a White piece on sq reads index sq ^ 56
+    // and a Black piece reads the mirrored index sq.
+    constexpr std::array<std::array<int32_t, 64>, 12> buildPsqt()
     {
-        Bitboard whitePieces = board.pieces(pt, White);
-        Bitboard blackPieces = board.pieces(pt, Black);
+        constexpr const int *PST[6] = {PAWN_PST, KNIGHT_PST, BISHOP_PST, ROOK_PST, QUEEN_PST, KING_MG_PST};
 
-        // WHITE
-        while (whitePieces)
-        {
-            Square sq = static_cast<Square>(pop_lsb(whitePieces));
-            score += PIECE_VALUES[pt];
+        std::array<std::array<int32_t, 64>, 12> table{};
 
-            int idx = squareToIndex(sq);
+        for (int pt = PAWN; pt <= KING; pt++)
+        {
+            // Kings are always on the board, their material cancels out
+            const int material = pt == KING ? 0 : PIECE_VALUES[pt];
 
-            switch (pt)
+            for (int sq = 0; sq < 64; sq++)
             {
-            case PAWN:
-                score += PAWN_PST[idx];
-                break;
-            case KNIGHT:
-                score += KNIGHT_PST[idx];
-                break;
-            case BISHOP:
-                score += BISHOP_PST[idx];
-                break;
-            case ROOK:
-                score += ROOK_PST[idx];
-                break;
-            case QUEEN:
-                score += QUEEN_PST[idx];
-                break;
-            case KING:
-                score += KING_MG_PST[idx] * (1.0f - endgameWeight) +
-                         KING_EG_PST[idx] * endgameWeight;
-                break;
+                const int mgWhite = PST[pt][sq ^ 56];
+                const int egWhite = pt == KING ? KING_EG_PST[sq ^ 56] : mgWhite;
+                const int mgBlack = PST[pt][sq];
+                const int egBlack = pt == KING ? KING_EG_PST[sq] : mgBlack;
+
+                table[pt][sq] = S(material + mgWhite, material + egWhite);
+                table[pt + 6][sq] = -S(material + mgBlack, material + egBlack);
             }
         }
 
-        // BLACK
-        while (blackPieces)
-        {
-            Square sq = static_cast<Square>(pop_lsb(blackPieces));
-            score -= PIECE_VALUES[pt];
+        return table;
+    }
 
-            int flippedIdx = getFlippedSquare(sq);
+    const std::array<std::array<int32_t, 64>, 12> PSQT = buildPsqt();
+
+    const std::array<uint8_t, 12> PHASE = {
+        PHASE_WEIGHTS[PAWN], PHASE_WEIGHTS[KNIGHT], PHASE_WEIGHTS[BISHOP], PHASE_WEIGHTS[ROOK], PHASE_WEIGHTS[QUEEN], PHASE_WEIGHTS[KING],
+        PHASE_WEIGHTS[PAWN], PHASE_WEIGHTS[KNIGHT], PHASE_WEIGHTS[BISHOP], PHASE_WEIGHTS[ROOK], PHASE_WEIGHTS[QUEEN], PHASE_WEIGHTS[KING]};
+}
+
+// Score from White's point of view
+static int evaluateWhite(const Board &board, PawnTable &pawnTable)
+{
+    const PawnEntry &pawns = pawnTable.probe(board);
+
+    // Material and piece-square terms are accumulated incrementally by the board
+    int score = taper(board.psqtScore, gamePhase(board));
 
-            switch (pt)
-            {
-            case PAWN:
-                score -= PAWN_PST[flippedIdx];
-                break;
-            case KNIGHT:
-                score -= KNIGHT_PST[flippedIdx];
-                break;
-            case BISHOP:
-                score -= BISHOP_PST[flippedIdx];
-                break;
-            case ROOK:
-                score -= ROOK_PST[flippedIdx];
-                break;
-            case QUEEN:
-                score -= QUEEN_PST[flippedIdx];
-                break;
-            case KING:
-                score -= KING_MG_PST[flippedIdx] * (1.0f - endgameWeight) +
-                         KING_EG_PST[flippedIdx] * endgameWeight;
-                break;
-            }
-        }
-    }
     // Bishop pair bonus
     if (popcount(board.pieces(BISHOP, White)) >= 2)
         score += 30;
@@ -116,11 +60,26 @@ int evaluate(const Board &board)
         score -= 20;
 
     //  //Evaluate PawnStructure
-    score += evaluatePawnStructure(board) * 0.8;
+    score += evaluatePawnStructure(board, pawns) * 0.8;
 
     // Evaluate center control
     score += evaluateCenterControl(board);
-    score += evaluatePieces(board);
+    score += evaluatePieces(board, pawns);
+    return score;
+}
+
+template <Color c>
+int evaluate(const Board &board, PawnTable &pawnTable)
+{
     // Return score from perspective of side to move
-    return board.sideToMove == White ? score : -score;
+    const int score = evaluateWhite(board, pawnTable);
+    return c == White ? score : -score;
+}
+
+template int evaluate<White>(const Board &board, PawnTable &pawnTable);
+template int evaluate<Black>(const Board &board, PawnTable &pawnTable);
+
+int evaluate(const Board &board, PawnTable &pawnTable)
+{
+    return board.sideToMove == White ? evaluate<White>(board, pawnTable) : evaluate<Black>(board, pawnTable);
 }
\ No newline at end of file
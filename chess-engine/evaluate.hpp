@@ -1,6 +1,7 @@
 #pragma once
 #include "chess.hpp"
 #include "types.hpp"
+#include "pawn_table.hpp"
 // Piece values for evaluation
 constexpr int PAWN_VALUE = 100;
 constexpr int KNIGHT_VALUE = 320;
@@ -10,11 +11,11 @@ constexpr int QUEEN_VALUE = 900;
 constexpr int KING_VALUE = 20000; // High value for king, not used in material counting
 constexpr int totalMaterial = 8000; // Total material value for game phase calculation
 
-const int PIECE_VALUES[6] = {
+constexpr int PIECE_VALUES[6] = {
     PAWN_VALUE, KNIGHT_VALUE, BISHOP_VALUE, ROOK_VALUE, QUEEN_VALUE, KING_VALUE};
 // Piece-Square Tables - values are from white's perspective
 // Pawns - encouraged to advance and control center
-const int PAWN_PST[64] = {
+constexpr int PAWN_PST[64] = {
     0, 0, 0, 0, 0, 0, 0, 0,
     50, 50, 50, 50, 50, 50, 50, 50,
     10, 10, 20, 30, 30, 20, 10, 10,
@@ -25,7 +26,7 @@ const int PAWN_PST[64] = {
     0, 0, 0, 0, 0, 0, 0, 0};
 
 // Knights - better near the center, poor at edges
-const int KNIGHT_PST[64] = {
+constexpr int KNIGHT_PST[64] = {
     -50, -40, -30, -30, -30, -30, -40, -50,
     -40, -20, 0, 0, 0, 0, -20, -40,
     -30, 0, 10, 15, 15, 10, 0, -30,
@@ -36,7 +37,7 @@ const int KNIGHT_PST[64] = {
     -50, -40, -30, -30, -30, -30, -40, -50};
 
 // Bishops - prefer diagonals and center influence
-const int BISHOP_PST[64] = {
+constexpr int BISHOP_PST[64] = {
     -20, -10, -10, -10, -10, -10, -10, -20,
     -10, 0, 0, 0, 0, 0, 0, -10,
     -10, 0, 10, 10, 10, 10, 0, -10,
@@ -47,7 +48,7 @@ const int BISHOP_PST[64] = {
     -20, -10, -10, -10, -10, -10, -10, -20};
 
 // Rooks - prefer open files and 7th rank
-const int ROOK_PST[64] = {
+constexpr int ROOK_PST[64] = {
     0, 0, 0, 0, 0, 0, 0, 0,
     5, 10, 10, 10, 10, 10, 10, 5,
     -5, 0, 0, 0, 0, 0, 0, -5,
@@ -58,7 +59,7 @@ const int ROOK_PST[64] = {
     0, 0, 0, 5, 5, 0, 0, 0};
 
 // Queens - combination of rook and bishop mobility
-const int QUEEN_PST[64] = {
+constexpr int QUEEN_PST[64] = {
     -20, -10, -10, -5, -5, -10, -10, -20,
     -10, 0, 0, 0, 0, 0, 0, -10,
     -10, 0, 5, 5, 5, 5, 0, -10,
@@ -69,7 +70,7 @@ const int QUEEN_PST[64] = {
     -20, -10, -10, -5, -5, -10, -10, -20};
 
 // Kings - Middle game - seek shelter, avoid center
-const int KING_MG_PST[64] = {
+constexpr int KING_MG_PST[64] = {
     -30, -40, -40, -50, -50, -40, -40, -30,
     -30, -40, -40, -50, -50, -40, -40, -30,
     -30, -40, -40, -50, -50, -40, -40, -30,
@@ -80,7 +81,7 @@ const int KING_MG_PST[64] = {
     20, 30, 10, 0, 0, 10, 30, 20};
 
 // Kings - Endgame - kings need to be active, seek center
-const int KING_EG_PST[64] = {
+constexpr int KING_EG_PST[64] = {
     -50, -40, -30, -20, -20, -30, -40, -50,
     -30, -20, -10, 0, 0, -10, -20, -30,
     -30, -10, 20, 30, 30, 20, -10, -30,
@@ -90,8 +91,36 @@ const int KING_EG_PST[64] = {
     -30, -30, 0, 0, 0, 0, -30, -30,
     -50, -30, -30, -30, -30, -30, -30, -50};
 
-// Function to determine game phase (0 = opening, 1 = endgame)
-inline float getGamePhase(const Board &board);
+// Packed middlegame/endgame score: eg in the upper 16 bits, mg in the lower 16,
+// so one integer add accumulates both halves of a term
+using ScorePair = int32_t;
 
-// Evaluate function with piece-square tables
-int evaluate(const Board &board);
\ No newline at end of file
+constexpr ScorePair S(int mg, int eg) { return ScorePair((uint32_t)eg << 16) + mg; }
+
+constexpr int mg_value(ScorePair s) { return int16_t(uint16_t(uint32_t(s))); }
+
+constexpr int eg_value(ScorePair s) { return int16_t(uint16_t(uint32_t(s + 0x8000) >> 16)); }
+
+// Phase weights per piece type, 24 = all minor and major pieces on the board
+constexpr int PHASE_WEIGHTS[6] = {0, 1, 1, 2, 4, 0};
+constexpr int MAX_PHASE = 24;
+
+// Integer game phase, MAX_PHASE = opening, 0 = bare kings and pawns.
+// The board keeps the raw sum incrementally, promotions can push it past MAX_PHASE.
+inline int gamePhase(const Board &board)
+{
+    return std::min<int>(board.phase, MAX_PHASE);
+}
+
+// Blend a packed score by game phase
+constexpr int taper(ScorePair s, int phase)
+{
+    return (mg_value(s) * phase + eg_value(s) * (MAX_PHASE - phase)) / MAX_PHASE;
+}
+
+// Evaluate function with piece-square tables, from the side to move's point of view
+int evaluate(const Board &board, PawnTable &pawnTable);
+
+// evaluate() for a side to move known at compile time, c must be board.sideToMove
+template <Color c>
+int evaluate(const Board &board, PawnTable &pawnTable);
\ No newline at end of file
@@ -1,12 +1,34 @@
 #include "evaluate_features.hpp"
 #include "evaluate.hpp" 
 #include "chess.hpp"
+#include "eval_masks.hpp"
 #include <vector>
 using namespace Chess;
 
 
-// Pawn Structure: isolated, doubled, passed pawns (basic skeleton)
-int evaluatePawnStructure(const Board &board) {
+// Squares attacked by the given pawns
+static Bitboard pawnAttacksOf(Bitboard pawns, Color color) {
+    return color == White ? Movegen::pawnLeftAttacks<White>(pawns) | Movegen::pawnRightAttacks<White>(pawns)
+                          : Movegen::pawnLeftAttacks<Black>(pawns) | Movegen::pawnRightAttacks<Black>(pawns);
+}
+
+// Pawns with no enemy pawn ahead of them on the same or an adjacent file
+static Bitboard passedPawns(const Board &board, Color color) {
+    // Every square an enemy pawn can still reach or attack on its way down the board
+    Bitboard front = frontSpan(board.pieces(PAWN, ~color), ~color);
+    front |= Movegen::shift<WEST>(front) | Movegen::shift<EAST>(front);
+
+    return board.pieces(PAWN, color) & ~front;
+}
+
+// Pawn-only terms, cached by the pawn table under the board's pawnKey
+void evaluatePawns(const Board &board, PawnEntry &entry) {
+    entry.passedPawns[White] = passedPawns(board, White);
+    entry.passedPawns[Black] = passedPawns(board, Black);
+
+    entry.pawnAttacks[White] = pawnAttacksOf(board.pieces(PAWN, White), White);
+    entry.pawnAttacks[Black] = pawnAttacksOf(board.pieces(PAWN, Black), Black);
+
     int score = 0;
     score -= evaluateDoubledPawns(board, White);
     score += evaluateDoubledPawns(board, Black);
@@ -14,11 +36,8 @@ int evaluatePawnStructure(const Board &board) {
     score -= evaluateIsolatedPawns(board, White);
     score += evaluateIsolatedPawns(board, Black);
 
-    score += evaluatePassedPawns(board, White);
-    score -= evaluatePassedPawns(board, Black);
-
-    score += evaluatePassedPawnSupport(board, White);
-    score -= evaluatePassedPawnSupport(board, Black);
+    score += evaluatePassedPawns(entry.passedPawns[White], White);
+    score -= evaluatePassedPawns(entry.passedPawns[Black], Black);
 
     score += evaluateConnectedPawns(board, White);
     score -= evaluateConnectedPawns(board, Black);
@@ -32,6 +51,16 @@ int evaluatePawnStructure(const Board &board) {
     score += evaluatePawnChains(board, White);
     score -= evaluatePawnChains(board, Black);
 
+    entry.score = score;
+}
+
+// Pawn Structure: cached pawn-only score plus the terms that also look at pieces
+int evaluatePawnStructure(const Board &board, const PawnEntry &pawns) {
+    int score = pawns.score;
+
+    score += evaluatePassedPawnSupport(board, White);
+    score -= evaluatePassedPawnSupport(board, Black);
+
     return score;
 }
 
@@ -40,20 +69,20 @@ int evaluateCenterControl(const Board& board) {
     int score = 0;
     const Square centerSquares[] = { SQ_D4, SQ_E4, SQ_D5, SQ_E5 };
 
-    Board tempBoard = board;
+    const U64 occupied = board.All();
 
     for (Square sq : centerSquares) {
-        auto piece = tempBoard.pieceAtB(sq);
+        auto piece = board.pieceAtB(sq);
         if (piece != None) {
-            if (tempBoard.colorOf(sq) == White)
+            if (board.colorOf(sq) == White)
                 score += 5;
-            else if (tempBoard.colorOf(sq) == Black)
+            else if (board.colorOf(sq) == Black)
                 score -= 5;
         }
 
             // Check for attackers on the center squares
-            U64 attackersWhite = tempBoard.attackersForSide(White, sq, tempBoard.occAll);
-            U64 attackersBlack = tempBoard.attackersForSide(Black, sq, tempBoard.occAll);
+            U64 attackersWhite = board.attackersForSide(White, sq, occupied);
+            U64 attackersBlack = board.attackersForSide(Black, sq, occupied);
         
             score += 3 * popcount(attackersWhite); // Bonus if white attacks center
             score -= 3 * popcount(attackersBlack); // Bonus if black attacks center
@@ -63,80 +92,37 @@ int evaluateCenterControl(const Board& board) {
 
 
 int evaluateDoubledPawns(const Board &board, Color color) {
-    int penalty = 0;
-    // Get all pawns of the specified color
     Bitboard pawns = board.pieces(PAWN, color);
 
-    // Iterate through each file (0 to 7)
-    for (int file = 0; file < 8; ++file) {
-        // Create a mask for the current file
-        Bitboard pawnsInFile = pawns & MASK_FILE[file];
-        // Count the number of pawns in that file
-        int count = popcount(pawnsInFile);
-        // If there are more than one pawn in the file, apply penalty
-        if (count > 1) {
-            penalty += (count - 1) * 10; // 10 points for each extra pawn in the file
-        }
-    }
-
-    return penalty;
+    // 10 points for every pawn beyond the first on its file
+    int files = popcount(fileFill(pawns) & MASK_RANK[0]);
+    return (popcount(pawns) - files) * 10;
 }
 
 
 int evaluateIsolatedPawns(const Board &board, Color color) {
     Bitboard pawns = board.pieces(PAWN, color);
-    int penalty = 0;
-
-    // Iterate through each file (0 to 7)
-    for (int file = 0; file < 8; ++file) {
-        Bitboard pawnsInFile = pawns & MASK_FILE[file]; 
-        // Check the left and right
-        Bitboard leftSupport = (file > 0) ? (pawns & MASK_FILE[file - 1]) : 0;
-        Bitboard rightSupport = (file < 7) ? (pawns & MASK_FILE[file + 1]) : 0;
-
-        // If no support from both sides 
-        if (pawnsInFile && !leftSupport && !rightSupport) {
-            penalty += popcount(pawnsInFile) * 15; // minus 15 points for each isolated pawn
-        }
-    }
+    Bitboard files = fileFill(pawns);
 
-    return penalty;
+    // No friendly pawn on either neighbouring file
+    Bitboard isolated = pawns & ~(Movegen::shift<WEST>(files) | Movegen::shift<EAST>(files));
+    return popcount(isolated) * 15;
 }
 
 
-int evaluatePassedPawns(const Board &board, Color color) {
-    Bitboard pawns = board.pieces(PAWN, color);
-    Bitboard enemyPawns = board.pieces(PAWN, ~color);
+int evaluatePassedPawns(Bitboard passed, Color color) {
     int bonus = 0;
 
-    while (pawns) {
-        Square sq = static_cast<Square>(pop_lsb(pawns));
-        int file = square_file(sq);
+    while (passed) {
+        Square sq = static_cast<Square>(pop_lsb(passed));
         int rank = square_rank(sq);
-        
-        Bitboard blockerZone = 0;
-
-        for (int df = -1; df <= 1; ++df) {
-            int f = file + df;
-            if (f < 0 || f > 7) continue;
-
-            if (color == White) {
-                for (int r = rank + 1; r <= 7; ++r)
-                    blockerZone |= (1ULL << (r * 8 + f));
-            } else {
-                for (int r = rank - 1; r >= 0; --r)
-                    blockerZone |= (1ULL << (r * 8 + f));
-            }
-        }
 
-        if ((blockerZone & enemyPawns) == 0) {
-            int advancement = (color == White) ? rank : (7 - rank);
-            bonus += advancement * 5 + 10;
+        int advancement = (color == White) ? rank : (7 - rank);
+        bonus += advancement * 5 + 10;
 
-            // Bonus point for queens-pawn
-            if (advancement >= 5)
-                bonus += 10;
-        }
+        // Bonus point for queens-pawn
+        if (advancement >= 5)
+            bonus += 10;
     }
 
     return bonus;
@@ -146,35 +132,18 @@ int evaluatePassedPawnSupport(const Board &board, Color color) {
     Bitboard pawns = board.pieces(PAWN, color);
     int bonus = 0;
 
-    // Create a mutable copy of the board to avoid const issues
-    Board &mutableBoard = const_cast<Board &>(board);
-
     while (pawns) {
         Square sq = static_cast<Square>(pop_lsb(pawns));
-        int file = square_file(sq);
         int rank = square_rank(sq);
 
         // Check if the pawn is passed
-        if ((mutableBoard.pieces(PAWN, ~color) & mutableBoard.SQUARES_BETWEEN_BB[sq][mutableBoard.KingSQ(~color)]) == 0) {
-            int dir = (color == White) ? 1 : -1;
-            int forwardRank = rank + dir;
-
-            Bitboard support = 0ULL;
-
-            // Create a mask for the squares in front of the pawn
-            if (forwardRank >= 0 && forwardRank < 8) {
-                if (file > 0)
-                    support |= 1ULL << (forwardRank * 8 + file - 1);
-                if (file < 7)
-                    support |= 1ULL << (forwardRank * 8 + file + 1);
-            }
-
-            // Calculate the support from pawns
-            int pawnSupporters = popcount(support & mutableBoard.pieces(PAWN, color));
+        if ((board.pieces(PAWN, ~color) & SQUARES_BETWEEN_BB[sq][board.KingSQ(~color)]) == 0) {
+            // Calculate the support from pawns diagonally in front of it
+            int pawnSupporters = popcount(PawnAttacks(sq, color) & board.pieces(PAWN, color));
             bonus += 15 * pawnSupporters;
 
             // Calculate the support from other pieces
-            Bitboard otherSupport = mutableBoard.attackersForSide(color, sq, mutableBoard.occAll) & ~mutableBoard.pieces(PAWN, color);
+            Bitboard otherSupport = board.attackersForSide(color, sq, board.All()) & ~board.pieces(PAWN, color);
             bonus += 5 * popcount(otherSupport);
 
             // Bonus for being close to promotion
@@ -186,106 +155,35 @@ int evaluatePassedPawnSupport(const Board &board, Color color) {
     return bonus;
 }
 
+// Pawns with a friendly pawn beside them or defending them
 int evaluateConnectedPawns(const Board &board, Color color) {
     Bitboard pawns = board.pieces(PAWN, color);
-    int bonus = 0;
+    Bitboard defended = pawnAttacksOf(pawns, color);
+    Bitboard beside = Movegen::shift<WEST>(pawns) | Movegen::shift<EAST>(pawns);
 
-    while (pawns) {
-        Square sq = static_cast<Square>(pop_lsb(pawns));
-        int file = square_file(sq);
-        int rank = square_rank(sq);
-
-        Bitboard connected = 0ULL;
-        int dir = (color == White) ? -1 : 1;
-        int forwardRank = rank + dir;
-
-        // Check for connected pawns in the same file and diagonally
-        if (file > 0 && forwardRank >= 0 && forwardRank < 8)
-            connected |= 1ULL << (forwardRank * 8 + file - 1);
-        if (file < 7 && forwardRank >= 0 && forwardRank < 8)
-            connected |= 1ULL << (forwardRank * 8 + file + 1);
-        if (file > 0)
-            connected |= 1ULL << (rank * 8 + file - 1);
-        if (file < 7)
-            connected |= 1ULL << (rank * 8 + file + 1);
-
-        if (connected & board.pieces(PAWN, color)) {
-            bonus += 12; // Bonus for connected pawns
-        }
-    }
-
-    return bonus;
+    return popcount(pawns & (defended | beside)) * 12;
 }
 
 int evaluatePhalanxPawns(const Board &board, Color color) {
     Bitboard pawns = board.pieces(PAWN, color);
-    int bonus = 0;
-
-    for (int rank = 0; rank < 8; ++rank) {
-        Bitboard pawnsInRank = pawns & MASK_RANK[rank];
-
-        // Tạo mặt nạ để tránh lỗi khi shift ngang
-        Bitboard safeLeftShift = pawnsInRank & ~MASK_FILE[7]; // loại bỏ tốt ở file H
-        Bitboard safeRightShift = pawnsInRank & ~MASK_FILE[0]; // loại bỏ tốt ở file A
 
-        // Cặp tốt liền nhau (phalanx)
-        Bitboard phalanx = (safeLeftShift << 1) & pawnsInRank;
-        bonus += 10 * popcount(phalanx);
+    // Pawns with a neighbour on their west side (pairs)
+    Bitboard phalanx = Movegen::shift<EAST>(pawns) & pawns;
 
-        // Chuỗi tốt dài hơn 2 (ví dụ A-B-C)
-        Bitboard extendedPhalanx = (phalanx << 1) & pawnsInRank;
-        bonus += 5 * popcount(extendedPhalanx);
-    }
+    // Pawns ending a chain of three or more (e.g. A-B-C)
+    Bitboard extendedPhalanx = Movegen::shift<EAST>(phalanx) & pawns;
 
-    return bonus;
+    return 10 * popcount(phalanx) + 5 * popcount(extendedPhalanx);
 }
 
 int evaluateBlockedPawns(const Board &board, Color color) {
-    Bitboard pawns = board.pieces(PAWN, color);
-    int penalty = 0;
-
-    while (pawns) {
-        Square sq = static_cast<Square>(pop_lsb(pawns));
-        int file = square_file(sq);
-        int rank = square_rank(sq);
-
-        // Check if the pawn is blocked
-        if ((color == White && rank == 6) || (color == Black && rank == 1)) {
-            penalty += 10; // Penalty for blocked pawn
-        }
-    }
-
-    return penalty;
+    // Pawns on the seventh rank
+    Bitboard pawns = board.pieces(PAWN, color) & MASK_RANK[color == White ? 6 : 1];
+    return popcount(pawns) * 10;
 }
 
 int evaluatePawnChains(const Board &board, Color color) {
+    // Bonus for each pawn defended by another pawn
     Bitboard pawns = board.pieces(PAWN, color);
-    int bonus = 0;
-
-    while (pawns) {
-        Square sq = static_cast<Square>(pop_lsb(pawns));
-        int file = square_file(sq);
-        int rank = square_rank(sq);
-
-        // Check if the pawn is part of a chain
-        if ((color == White && rank == 0) || (color == Black && rank == 7))
-            continue;
-
-        // Check for pawns in the same file and diagonally
-        Bitboard protectors = 0ULL;
-        if (color == White && rank > 0) {
-            if (file > 0) protectors |= 1ULL << ((rank - 1) * 8 + (file - 1));
-            if (file < 7) protectors |= 1ULL << ((rank - 1) * 8 + (file + 1));
-        } else if (color == Black && rank < 7) {
-            if (file > 0) protectors |= 1ULL << ((rank + 1) * 8 + (file - 1));
-            if (file < 7) protectors |= 1ULL << ((rank + 1) * 8 + (file + 1));
-        }
-
-        // Bonus for each pawn in the chain
-        if (protectors & board.pieces(PAWN, color)) {
-            bonus += 15;
-        }
-    }
-
-    return bonus;
+    return popcount(pawns & pawnAttacksOf(pawns, color)) * 15;
 }
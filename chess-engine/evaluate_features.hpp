@@ -1,16 +1,20 @@
 #pragma once
 
 #include "chess.hpp" 
+#include "pawn_table.hpp"
 using namespace Chess;
 
-int evaluatePawnStructure(const Board& board);
+// Fills a pawn table entry with every term that depends on pawns only
+void evaluatePawns(const Board& board, PawnEntry& entry);
+
+int evaluatePawnStructure(const Board& board, const PawnEntry& pawns);
 int evaluateCenterControl(const Board& board);
 
 int evaluateDoubledPawns(const Board &board, Color color);
 int evaluateIsolatedPawns(const Board &board, Color color);
-int evaluatePassedPawns(const Board &board, Color color);
+int evaluatePassedPawns(Bitboard passed, Color color);
 int evaluatePhalanxPawns(const Board &board, Color color);
 int evaluatePassedPawnSupport(const Board &board, Color color);
 int evaluateBlockedPawns(const Board &board, Color color);
 int evaluatePawnChains(const Board &board, Color color);
-int evaluateConnectedPawns(const Board &board, Color color);
\ No newline at end of file
+int evaluateConnectedPawns(const Board &board, Color color);
@@ -3,65 +3,9 @@
 
 using namespace Chess;
 
-// Helper functions
-Bitboard getKingRing(const Board& board, Color color) {
-   
-    Square kingSq = board.KingSQ(color);
-    Bitboard kingRing = 0;
-    
-    // Add all squares adjacent to the king
-    for (int dr = -1; dr <= 1; dr++) {
-        for (int df = -1; df <= 1; df++) {
-            if (dr == 0 && df == 0) continue; // Skip the king square itself
-            
-            int r = square_rank(kingSq) + dr;
-            int f = square_file(kingSq) + df;
-            
-            if (r >= 0 && r < 8 && f >= 0 && f < 8) {
-                kingRing |= 1ULL << (r * 8 + f);
-            }
-        }
-    }
-
-    return kingRing;
-}
-
-bool canPawnAttackSquare(const Board& board, Square sq, Color attackingColor) {
-    int rank = square_rank(sq);
-    int file = square_file(sq);
-    Bitboard enemyPawns = board.pieces(PAWN, attackingColor);
-    
-    if (attackingColor == White) {
-        // Check if white pawns can attack this square (from black's perspective)
-        if (file > 0 && rank < 7 && (enemyPawns & (1ULL << ((rank + 1) * 8 + file - 1)))) return true;
-        if (file < 7 && rank < 7 && (enemyPawns & (1ULL << ((rank + 1) * 8 + file + 1)))) return true;
-    } else {
-        // Check if black pawns can attack this square (from white's perspective)
-        if (file > 0 && rank > 0 && (enemyPawns & (1ULL << ((rank - 1) * 8 + file - 1)))) return true;
-        if (file < 7 && rank > 0 && (enemyPawns & (1ULL << ((rank - 1) * 8 + file + 1)))) return true;
-    }
-    
-    return false;
-}
-
-bool isPawnProtected(const Board& board, Square sq, Color color) {
-    int rank = square_rank(sq);
-    int file = square_file(sq);
-    Bitboard pawns = board.pieces(PAWN, color);
-    
-    if (color == White) {
-        if (file > 0 && rank > 0 && (pawns & (1ULL << ((rank - 1) * 8 + file - 1)))) return true;
-        if (file < 7 && rank > 0 && (pawns & (1ULL << ((rank - 1) * 8 + file + 1)))) return true;
-    } else {
-        if (file > 0 && rank < 7 && (pawns & (1ULL << ((rank + 1) * 8 + file - 1)))) return true;
-        if (file < 7 && rank < 7 && (pawns & (1ULL << ((rank + 1) * 8 + file + 1)))) return true;
-    }
-    
-    return false;
-}
-
 // Unified evaluation for pieces attacking king ring
-void evaluatePiecesAttackingKingRing(EvalInfo& ei, Color color, int& attackCount) {
+template <Color color>
+void evaluatePiecesAttackingKingRing(EvalInfo& ei, int& attackCount) {
     Bitboard enemyKingRing = ei.kingRings[~color];
     attackCount = 0;
     
@@ -74,8 +18,7 @@ void evaluatePiecesAttackingKingRing(EvalInfo& ei, Color color, int& attackCount
         int attackedSquares = popcount(attacks & enemyKingRing);
         
         if (attackedSquares > 0) {
-            ei.mgScore += 10 * attackedSquares * (color == White ? 1 : -1);
-            ei.egScore += 5 * attackedSquares * (color == White ? 1 : -1);
+            ei.score += S(10, 5) * attackedSquares * SIGN<color>;
             attackCount++;
         }
     }
@@ -89,8 +32,7 @@ void evaluatePiecesAttackingKingRing(EvalInfo& ei, Color color, int& attackCount
         int attackedSquares = popcount(attacks & enemyKingRing);
         
         if (attackedSquares > 0) {
-            ei.mgScore += 10 * attackedSquares * (color == White ? 1 : -1);
-            ei.egScore += 5 * attackedSquares * (color == White ? 1 : -1);
+            ei.score += S(10, 5) * attackedSquares * SIGN<color>;
             attackCount++;
         }
     }
@@ -104,8 +46,7 @@ void evaluatePiecesAttackingKingRing(EvalInfo& ei, Color color, int& attackCount
         int attackedSquares = popcount(attacks & enemyKingRing);
         
         if (attackedSquares > 0) {
-            ei.mgScore += 15 * attackedSquares * (color == White ? 1 : -1);
-            ei.egScore += 8 * attackedSquares * (color == White ? 1 : -1);
+            ei.score += S(15, 8) * attackedSquares * SIGN<color>;
             attackCount++;
         }
     }
@@ -119,35 +60,27 @@ void evaluatePiecesAttackingKingRing(EvalInfo& ei, Color color, int& attackCount
         int attackedSquares = popcount(attacks & enemyKingRing);
         
         if (attackedSquares > 0) {
-            ei.mgScore += 20 * attackedSquares * (color == White ? 1 : -1);
-            ei.egScore += 10 * attackedSquares * (color == White ? 1 : -1);
+            ei.score += S(20, 10) * attackedSquares * SIGN<color>;
             attackCount++;
         }
     }
     
     // Bonus for multiple attackers
     if (attackCount >= 2) {
-        ei.mgScore += 10 * attackCount * (color == White ? 1 : -1);
+        ei.score += S(10, 0) * attackCount * SIGN<color>;
     }
 }
 
 // Unified evaluation for outposts
-void evaluateOutposts(EvalInfo& ei, Color color) {
+template <Color color>
+void evaluateOutposts(EvalInfo& ei) {
     Bitboard knights = ei.board.pieces(KNIGHT, color);
     Bitboard bishops = ei.board.pieces(BISHOP, color);
     Bitboard potentialOutposts = ei.outpostSquares[color];
     int bonus = 0;
     
     // Filter out squares that can be attacked by enemy pawns
-    Bitboard safeOutposts = 0;
-    Bitboard outpostTemp = potentialOutposts;
-    
-    while (outpostTemp) {
-        Square sq = static_cast<Square>(pop_lsb(outpostTemp));
-        if (!canPawnAttackSquare(ei.board, sq, ~color)) {
-            safeOutposts |= (1ULL << sq);
-        }
-    }
+    Bitboard safeOutposts = potentialOutposts & ~ei.pawns.pawnAttacks[~color];
     
     // Evaluate knights in outposts
     while (knights) {
@@ -157,7 +90,7 @@ void evaluateOutposts(EvalInfo& ei, Color color) {
             bonus += 20;
             
             // Extra bonus if protected by pawn
-            if (isPawnProtected(ei.board, sq, color)) {
+            if (ei.pawns.pawnAttacks[color] & (1ULL << sq)) {
                 bonus += 10;
             }
             
@@ -183,7 +116,7 @@ void evaluateOutposts(EvalInfo& ei, Color color) {
             bonus += 15;
             
             // Extra bonus if protected by pawn
-            if (isPawnProtected(ei.board, sq, color)) {
+            if (ei.pawns.pawnAttacks[color] & (1ULL << sq)) {
                 bonus += 8;
             }
         } else {
@@ -196,12 +129,12 @@ void evaluateOutposts(EvalInfo& ei, Color color) {
     }
     
     // Apply outpost bonus
-    ei.mgScore += bonus * (color == White ? 1 : -1);
-    ei.egScore += (bonus / 2) * (color == White ? 1 : -1); // Less important in endgame
+    ei.score += S(bonus, bonus / 2) * SIGN<color>; // Less important in endgame
 }
 
 // Unified rook evaluation
-void evaluateRooks(EvalInfo& ei, Color color) {
+template <Color color>
+void evaluateRooks(EvalInfo& ei) {
     Bitboard rooks = ei.board.pieces(ROOK, color);
     Bitboard pawnsAll = ei.board.pieces(PAWN, White) | ei.board.pieces(PAWN, Black);
     int bonus = 0;
@@ -226,7 +159,7 @@ void evaluateRooks(EvalInfo& ei, Color color) {
         
         // Evaluate trapped rook
         bool isTrapped = false;
-        if (color == White) {
+        if constexpr (color == White) {
             if (rank == 0 && (file == 0 || file == 7)) {
                 Square adjacentSquare = (file == 0) ? SQ_B1 : SQ_G1;
                 if (ei.board.pieceAtB(adjacentSquare) == WhiteKing) {
@@ -265,12 +198,12 @@ void evaluateRooks(EvalInfo& ei, Color color) {
     }
     
     // Apply rook bonus
-    ei.mgScore += bonus * (color == White ? 1 : -1);
-    ei.egScore += bonus * (color == White ? 1 : -1); // Rooks equally important in endgame
+    ei.score += S(bonus, bonus) * SIGN<color>; // Rooks equally important in endgame
 }
 
 // Unified bishop evaluation
-void evaluateBishops(EvalInfo& ei, Color color) {
+template <Color color>
+void evaluateBishops(EvalInfo& ei) {
     Bitboard bishops = ei.board.pieces(BISHOP, color);
     Bitboard pawns = ei.board.pieces(PAWN, color);
     int bonus = 0;
@@ -299,39 +232,13 @@ void evaluateBishops(EvalInfo& ei, Color color) {
         }
         
         // Bishop behind pawn
-        int file = square_file(sq);
-        int rank = square_rank(sq);
-        
-        // Look for pawns in front of the bishop
-        if (color == White) {
-            for (int r = rank + 1; r < 8; r++) {
-                if (pawns & (1ULL << (r * 8 + file))) {
-                    bonus += 5;
-                    break;
-                }
-            }
-        } else {
-            for (int r = rank - 1; r >= 0; r--) {
-                if (pawns & (1ULL << (r * 8 + file))) {
-                    bonus += 5;
-                    break;
-                }
-            }
+        if (FORWARD_FILE[color][sq] & pawns) {
+            bonus += 5;
         }
         
         // Evaluate bishop pawns (pawns on same colored squares)
-        bool isDarkSquare = ((square_rank(sq) + square_file(sq)) % 2) == 1;
-        int sameColorPawns = 0;
-        Bitboard pawnsCopy = pawns;
-        
-        while (pawnsCopy) {
-            Square pawnSq = static_cast<Square>(pop_lsb(pawnsCopy));
-            bool isPawnOnDark = ((square_rank(pawnSq) + square_file(pawnSq)) % 2) == 1;
-            
-            if (isPawnOnDark == isDarkSquare) {
-                sameColorPawns++;
-            }
-        }
+        Bitboard sameColorSquares = (LIGHT_SQUARES & bishopBB) ? LIGHT_SQUARES : ~LIGHT_SQUARES;
+        int sameColorPawns = popcount(pawns & sameColorSquares);
         
         // Penalty for having many pawns on same colored squares as bishop
         if (sameColorPawns >= 3) {
@@ -339,7 +246,7 @@ void evaluateBishops(EvalInfo& ei, Color color) {
         }
         
         // Evaluate bishop x-ray attacks
-        Bitboard enemyPieces = ei.board.occAll & ~ei.board.Us(color);
+        Bitboard enemyPieces = ei.board.Enemy(color);
 
         // Using empty board for x-ray attacks
         Bitboard xrayAttacks = BishopAttacks(sq, 0);
@@ -360,12 +267,12 @@ void evaluateBishops(EvalInfo& ei, Color color) {
     }
     
     // Apply bishop bonus
-    ei.mgScore += bonus * (color == White ? 1 : -1);
-    ei.egScore += bonus * (color == White ? 1 : -1);
+    ei.score += S(bonus, bonus) * SIGN<color>;
 }
 
 // Unified knight evaluation
-void evaluateKnights(EvalInfo& ei, Color color) {
+template <Color color>
+void evaluateKnights(EvalInfo& ei) {
     Bitboard knights = ei.board.pieces(KNIGHT, color);
     int bonus = 0;
     
@@ -388,35 +295,18 @@ void evaluateKnights(EvalInfo& ei, Color color) {
         }
         
         // Minor behind pawn
-        int file = square_file(sq);
-        int rank = square_rank(sq);
-        Bitboard pawns = ei.board.pieces(PAWN, color);
-        
-        // Look for pawns in front of the knight
-        if (color == White) {
-            for (int r = rank + 1; r < 8; r++) {
-                if (pawns & (1ULL << (r * 8 + file))) {
-                    bonus += 5;
-                    break;
-                }
-            }
-        } else {
-            for (int r = rank - 1; r >= 0; r--) {
-                if (pawns & (1ULL << (r * 8 + file))) {
-                    bonus += 5;
-                    break;
-                }
-            }
+        if (FORWARD_FILE[color][sq] & ei.board.pieces(PAWN, color)) {
+            bonus += 5;
         }
     }
     
     // Apply knight bonus
-    ei.mgScore += bonus * (color == White ? 1 : -1);
-    ei.egScore += bonus * (color == White ? 1 : -1);
+    ei.score += S(bonus, bonus) * SIGN<color>;
 }
 
 // Unified queen evaluation
-void evaluateQueens(EvalInfo& ei, Color color) {
+template <Color color>
+void evaluateQueens(EvalInfo& ei) {
     Bitboard queens = ei.board.pieces(QUEEN, color);
     int bonus = 0;
     
@@ -448,10 +338,9 @@ void evaluateQueens(EvalInfo& ei, Color color) {
     
     // Queen safety
 
-    Board mutableBoard = ei.board;
-    Bitboard enemyAttackers = mutableBoard.attackersForSide(~color, queenSq, mutableBoard.All());
+    Bitboard enemyAttackers = ei.board.attackersForSide(~color, queenSq, ei.board.All());
     int numAttackers = popcount(enemyAttackers);
-    Bitboard defenders = mutableBoard.attackersForSide(color, queenSq, ei.board.All()) & ~queens;
+    Bitboard defenders = ei.board.attackersForSide(color, queenSq, ei.board.All()) & ~queens;
     int numDefenders = popcount(defenders);
     
     if (numAttackers > numDefenders) {
@@ -459,7 +348,7 @@ void evaluateQueens(EvalInfo& ei, Color color) {
     }
     
     // Early queen development penalty
-    if (color == White) {
+    if constexpr (color == White) {
         if (queenSq != SQ_D1) {
             // Check for developed minor pieces
             int developedPieces = popcount(ei.board.pieces(KNIGHT, White) & ~0x42ULL) + // Knights not on b1,g1
@@ -487,51 +376,22 @@ void evaluateQueens(EvalInfo& ei, Color color) {
     }
     
     // Apply queen bonus
-    ei.mgScore += bonus * (color == White ? 1 : -1);
-    ei.egScore += bonus * (color == White ? 1 : -1);
+    ei.score += S(bonus, bonus) * SIGN<color>;
 }
 
 // King evaluation
-void evaluateKingSafety(EvalInfo& ei, Color color) {
+template <Color color>
+void evaluateKingSafety(EvalInfo& ei) {
     Square kingSq = ei.board.KingSQ(color);
     int bonus = 0;
     
     // Protectors around the king
-    Board mutableBoard = ei.board;
-    Bitboard protectors = mutableBoard.attackersForSide(color, kingSq, ei.board.All());
+    Bitboard protectors = ei.board.attackersForSide(color, kingSq, ei.board.All());
     int numProtectors = popcount(protectors);
     bonus += numProtectors * 5;
     
-    // Pawn shield
-    int pawnShield = 0;
-    int file = square_file(kingSq);
-    int rank = square_rank(kingSq);
-    
-    // Check for pawns in front of the king
-    if (color == White && rank < 7) {
-        Bitboard frontSquares = 0;
-        
-        // Define area in front of king
-        for (int f = std::max(0, file - 1); f <= std::min(7, file + 1); f++) {
-            for (int r = rank + 1; r <= std::min(7, rank + 2); r++) {
-                frontSquares |= 1ULL << (r * 8 + f);
-            }
-        }
-        
-        pawnShield = popcount(frontSquares & ei.board.pieces(PAWN, White));
-    } 
-    else if (color == Black && rank > 0) {
-        Bitboard frontSquares = 0;
-        
-        // Define area in front of king
-        for (int f = std::max(0, file - 1); f <= std::min(7, file + 1); f++) {
-            for (int r = std::max(0, rank - 2); r < rank; r++) {
-                frontSquares |= 1ULL << (r * 8 + f);
-            }
-        }
-        
-        pawnShield = popcount(frontSquares & ei.board.pieces(PAWN, Black));
-    }
+    // Pawn shield: own pawns on the two ranks in front of the king
+    int pawnShield = popcount(SHIELD_ZONE[color][kingSq] & ei.board.pieces(PAWN, color));
     
     bonus += pawnShield * 10;
     
@@ -568,102 +428,41 @@ void evaluateKingSafety(EvalInfo& ei, Color color) {
     }
     
     // Apply king safety bonus (more important in middlegame)
-    ei.mgScore += bonus * (color == White ? 1 : -1);
-    ei.egScore += (bonus / 3) * (color == White ? 1 : -1); // Less important in endgame
+    ei.score += S(bonus, bonus / 3) * SIGN<color>; // Less important in endgame
 }
 
-// Main evaluation functions
-int evaluatePiecesMg(const Board& board) {
-    EvalInfo ei(board);
+// Main evaluation function: every piece term is computed once and
+// accumulated into a packed (mg, eg) pair, then tapered by game phase
+int evaluatePieces(const Board& board, const PawnEntry& pawns) {
+    EvalInfo ei(board, pawns);
     
     // Piece attack counters
     int whiteAttackers = 0, blackAttackers = 0;
     
     // Evaluate king safety
-    evaluateKingSafety(ei, White);
-    evaluateKingSafety(ei, Black);
-    
-    // Evaluate pieces attacking king ring
-    evaluatePiecesAttackingKingRing(ei, White, whiteAttackers);
-    evaluatePiecesAttackingKingRing(ei, Black, blackAttackers);
-    
-    // Evaluate outposts
-    evaluateOutposts(ei, White);
-    evaluateOutposts(ei, Black);
-    
-    // Evaluate piece-specific features
-    evaluateRooks(ei, White);
-    evaluateRooks(ei, Black);
-    
-    evaluateBishops(ei, White);
-    evaluateBishops(ei, Black);
-    
-    evaluateKnights(ei, White);
-    evaluateKnights(ei, Black);
-    
-    evaluateQueens(ei, White);
-    evaluateQueens(ei, Black);
-    
-    return ei.mgScore;
-}
-
-int evaluatePiecesEg(const Board& board) {
-    EvalInfo ei(board);
-    
-    // Piece attack counters
-    int whiteAttackers = 0, blackAttackers = 0;
-    
-    // Evaluate king safety (less important in endgame)
-    evaluateKingSafety(ei, White);
-    evaluateKingSafety(ei, Black);
+    evaluateKingSafety<White>(ei);
+    evaluateKingSafety<Black>(ei);
     
     // Evaluate pieces attacking king ring
-    evaluatePiecesAttackingKingRing(ei, White, whiteAttackers);
-    evaluatePiecesAttackingKingRing(ei, Black, blackAttackers);
+    evaluatePiecesAttackingKingRing<White>(ei, whiteAttackers);
+    evaluatePiecesAttackingKingRing<Black>(ei, blackAttackers);
     
     // Evaluate outposts
-    evaluateOutposts(ei, White);
-    evaluateOutposts(ei, Black);
+    evaluateOutposts<White>(ei);
+    evaluateOutposts<Black>(ei);
     
     // Evaluate piece-specific features
-    evaluateRooks(ei, White);
-    evaluateRooks(ei, Black);
+    evaluateRooks<White>(ei);
+    evaluateRooks<Black>(ei);
     
-    evaluateBishops(ei, White);
-    evaluateBishops(ei, Black);
+    evaluateBishops<White>(ei);
+    evaluateBishops<Black>(ei);
     
-    evaluateKnights(ei, White);
-    evaluateKnights(ei, Black);
+    evaluateKnights<White>(ei);
+    evaluateKnights<Black>(ei);
     
-    evaluateQueens(ei, White);
-    evaluateQueens(ei, Black);
+    evaluateQueens<White>(ei);
+    evaluateQueens<Black>(ei);
     
-    return ei.egScore;
+    return taper(ei.score, gamePhase(board));
 }
-
-// Helper function to determine if position is in endgame
-bool isEndgame(const Board& board) {
-    // Simple endgame detection - count material without pawns
-    int materialCount = 0;
-    
-    materialCount += popcount(board.pieces(KNIGHT, White) | board.pieces(KNIGHT, Black)) * 3;
-    materialCount += popcount(board.pieces(BISHOP, White) | board.pieces(BISHOP, Black)) * 3;
-    materialCount += popcount(board.pieces(ROOK, White) | board.pieces(ROOK, Black)) * 5;
-    materialCount += popcount(board.pieces(QUEEN, White) | board.pieces(QUEEN, Black)) * 9;
-    
-    return materialCount <= 12; // Arbitrary threshold
-}
-
-// Main evaluation function
-int evaluatePieces(const Board& board) {
-    int mgScore = evaluatePiecesMg(board);
-    int egScore = evaluatePiecesEg(board);
-    
-    // For simplicity, we'll use a linear interpolation based on total material
-    bool inEndgame = isEndgame(board);
-    int finalScore = inEndgame ? egScore : mgScore;
-    finalScore = (((mgScore * inEndgame + ((egScore * (128 - inEndgame)) << 0)) / 128) << 0);
-
-    // Return the score from the perspective of the side to move
-    return finalScore;
-}
\ No newline at end of file
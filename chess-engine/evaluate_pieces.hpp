@@ -3,48 +3,47 @@
 
 #include "types.hpp"  // Include this first to get basic types
 #include "chess.hpp"  // Then include chess.hpp for the full implementation
-
-Chess::Bitboard getKingRing(const Chess::Board& board, Chess::Color color);
+#include "evaluate.hpp"  // Packed mg/eg scores and phase tapering
+#include "pawn_table.hpp"  // Cached pawn attacks
+#include "eval_masks.hpp"  // King rings, shield zones and outpost masks
 
 // Helper structures
 struct EvalInfo {
     const Chess::Board& board;
-    int mgScore;
-    int egScore;
+    const PawnEntry& pawns;
+    ScorePair score;
     
     // Cached bitboards
     Chess::Bitboard kingRings[2];
     Chess::Bitboard outpostSquares[2];
     
-    EvalInfo(const Chess::Board& b) : board(b), mgScore(0), egScore(0) {
+    EvalInfo(const Chess::Board& b, const PawnEntry& p) : board(b), pawns(p), score(0) {
         // Initialize king rings
-        kingRings[Chess::White] = getKingRing(board, Chess::White);
-        kingRings[Chess::Black] = getKingRing(board, Chess::Black);
+        kingRings[Chess::White] = KING_RING[board.KingSQ(Chess::White)];
+        kingRings[Chess::Black] = KING_RING[board.KingSQ(Chess::Black)];
         
         // Initialize outpost squares
-        outpostSquares[Chess::White] = 0x00007E7E00000000ULL; // White outpost squares (ranks 4-5)
-        outpostSquares[Chess::Black] = 0x00000000007E7E00ULL; // Black outpost squares (ranks 3-4)
+        outpostSquares[Chess::White] = OUTPOST_SQUARES[Chess::White];
+        outpostSquares[Chess::Black] = OUTPOST_SQUARES[Chess::Black];
     }
 };
 
 // Helper functions
 
-bool canPawnAttackSquare(const Chess::Board& board, Chess::Square sq, Chess::Color attackingColor);
-bool isPawnProtected(const Chess::Board& board, Chess::Square sq, Chess::Color color);
-
-// Function declarations for evaluation
-void evaluatePiecesAttackingKingRing(EvalInfo& ei, Chess::Color color, int& attackCount);
-void evaluateOutposts(EvalInfo& ei, Chess::Color color);
-void evaluateRooks(EvalInfo& ei, Chess::Color color);
-void evaluateBishops(EvalInfo& ei, Chess::Color color);
-void evaluateKnights(EvalInfo& ei, Chess::Color color);
-void evaluateQueens(EvalInfo& ei, Chess::Color color);
-void evaluateKingSafety(EvalInfo& ei, Chess::Color color);
-
-// Main evaluation functions
-int evaluatePiecesMg(const Chess::Board& board);
-int evaluatePiecesEg(const Chess::Board& board);
-int evaluatePieces(const Chess::Board& board);
-bool isEndgame(const Chess::Board& board);
+// +1 for White's terms, -1 for Black's, the score is kept from White's point of view
+template <Chess::Color c>
+constexpr int SIGN = c == Chess::White ? 1 : -1;
+
+// Function declarations for evaluation, one instantiation per colour
+template <Chess::Color color> void evaluatePiecesAttackingKingRing(EvalInfo& ei, int& attackCount);
+template <Chess::Color color> void evaluateOutposts(EvalInfo& ei);
+template <Chess::Color color> void evaluateRooks(EvalInfo& ei);
+template <Chess::Color color> void evaluateBishops(EvalInfo& ei);
+template <Chess::Color color> void evaluateKnights(EvalInfo& ei);
+template <Chess::Color color> void evaluateQueens(EvalInfo& ei);
+template <Chess::Color color> void evaluateKingSafety(EvalInfo& ei);
+
+// Main evaluation function
+int evaluatePieces(const Chess::Board& board, const PawnEntry& pawns);
 
 #endif // EVALUATE_PIECES_HPP
\ No newline at end of file
@@ -5,11 +5,10 @@
 
 namespace misc {
 
-template<typename Duration = std::chrono::milliseconds>
-inline double tick()
+/// @brief microseconds on the monotonic clock, only differences are meaningful
+inline int64_t now()
 {
-    
-    return (double)std::chrono::duration_cast<Duration>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
-}
\ No newline at end of file
+}
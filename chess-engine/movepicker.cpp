@@ -0,0 +1,151 @@
+#include "movepicker.hpp"
+#include "score_move.hpp"
+
+// Captures that lose more than this by SEE wait until all quiets are tried
+constexpr int GoodCaptureMargin = -107;
+
+/// @brief captures, promotions and en passant, the moves CAPTURE generation produces
+template <Color c>
+static bool isNoisy(const Board &board, Move move)
+{
+   const Square target = to(move);
+
+   if (promoted(move))
+      return true;
+   if (board.pieceAtB(target) != None)
+      return board.colorOf(target) != c;
+   return piece(move) == PAWN && target == board.enPassantSquare;
+}
+
+template <Color c>
+MovePicker<c>::MovePicker(SearchThread &st, SearchStack *ss, Move ttMove, const CheckInfo &ci)
+    : st(st), board(st.board), ss(ss), checkInfo(&ci), ttMove(ttMove), killers{ss->killers[0], ss->killers[1]},
+      stage(TT_MOVE)
+{
+   if (!Movegen::isLegal<c>(board, ttMove))
+      this->ttMove = NO_MOVE;
+}
+
+template <Color c>
+MovePicker<c>::MovePicker(SearchThread &st, Move ttMove)
+    : st(st), board(st.board), ss(nullptr), checkInfo(nullptr), ttMove(ttMove), killers{NO_MOVE, NO_MOVE},
+      stage(QS_TT_MOVE)
+{
+   if (!isNoisy<c>(board, ttMove) || !Movegen::isLegal<c>(board, ttMove))
+      this->ttMove = NO_MOVE;
+}
+
+template <Color c>
+bool MovePicker<c>::usableKiller(Move move)
+{
+   // Killers are quiet moves from sibling nodes and may not even be legal here
+   return move != NO_MOVE && move != ttMove && !isNoisy<c>(board, move) && Movegen::isLegal<c>(board, move);
+}
+
+template <Color c>
+Move MovePicker<c>::selectNext(Movelist &list)
+{
+   while (current < list.size)
+   {
+      pickNextMove(current, list);
+      const Move move = list[current++].move;
+
+      if (move != ttMove && (&list != &quiets || !isKiller(move)))
+         return move;
+   }
+
+   return NO_MOVE;
+}
+
+template <Color c>
+Move MovePicker<c>::next(bool skipQuiets)
+{
+   Move move;
+
+   switch (stage)
+   {
+   case TT_MOVE:
+   case QS_TT_MOVE:
+      stage++;
+      if (ttMove != NO_MOVE)
+         return ttMove;
+      [[fallthrough]];
+
+   case INIT_CAPTURES:
+   case QS_INIT_CAPTURES:
+      Movegen::legalmoves<c, CAPTURE>(board, captures);
+      for (ExtMove &capture : captures)
+         capture.value = scoreCapture(board, capture.move);
+
+      current = 0;
+      stage++;
+      [[fallthrough]];
+
+   case GOOD_CAPTURES:
+   case QS_GOOD_CAPTURES:
+      // SEE is only paid for the captures we actually reach
+      while ((move = selectNext(captures)) != NO_MOVE)
+      {
+         if (see(board, move, GoodCaptureMargin))
+            return move;
+         badCaptures.Add(move);
+      }
+
+      current = 0;
+      if (stage == QS_GOOD_CAPTURES)
+      {
+         stage = QS_BAD_CAPTURES;
+         return next();
+      }
+      stage++;
+      [[fallthrough]];
+
+   case KILLER_1:
+      stage++;
+      if (!skipQuiets && usableKiller(killers[0]))
+         return killers[0];
+      [[fallthrough]];
+
+   case KILLER_2:
+      stage++;
+      if (!skipQuiets && killers[1] != killers[0] && usableKiller(killers[1]))
+         return killers[1];
+      [[fallthrough]];
+
+   case INIT_QUIETS:
+      if (!skipQuiets)
+      {
+         Movegen::legalmoves<c, QUIET>(board, quiets);
+         for (ExtMove &quiet : quiets)
+            quiet.value = scoreQuiet(st, ss, quiet.move, *checkInfo);
+      }
+
+      current = 0;
+      stage++;
+      [[fallthrough]];
+
+   case QUIETS:
+      if (!skipQuiets && (move = selectNext(quiets)) != NO_MOVE)
+         return move;
+
+      current = 0;
+      stage++;
+      [[fallthrough]];
+
+   case BAD_CAPTURES:
+   case QS_BAD_CAPTURES:
+      // Already in MVV-LVA order, they were set aside in the order they were picked
+      if (current < badCaptures.size)
+         return badCaptures[current++].move;
+
+      stage = PICKER_DONE;
+      [[fallthrough]];
+
+   case PICKER_DONE:
+   default:
+      return NO_MOVE;
+   }
+}
+
+template class MovePicker<White>;
+template class MovePicker<Black>;
@@ -0,0 +1,72 @@
+#pragma once
+#include "chess.hpp"
+#include "search.hpp"
+
+// Stages of the move picker, in the order they are walked
+enum PickerStage : uint8_t
+{
+   // Main search
+   TT_MOVE,
+   INIT_CAPTURES,
+   GOOD_CAPTURES,
+   KILLER_1,
+   KILLER_2,
+   INIT_QUIETS,
+   QUIETS,
+   BAD_CAPTURES,
+
+   // Quiescence search and ProbCut
+   QS_TT_MOVE,
+   QS_INIT_CAPTURES,
+   QS_GOOD_CAPTURES,
+   QS_BAD_CAPTURES,
+
+   PICKER_DONE
+};
+
+/// @brief Hands out the moves of a position one at a time, best guess first.
+/// Every stage is only generated and scored once the previous ones ran out,
+/// so a node that cuts off on the TT move never generates anything.
+/// @tparam c the side to move, generation and legality checks skip the runtime dispatch
+template <Color c>
+class MovePicker
+{
+ public:
+   /// @brief all legal moves, for the main search
+   /// @param ci checkInfo() of the position, quiet checks are tried first among the quiets
+   MovePicker(SearchThread &st, SearchStack *ss, Move ttMove, const CheckInfo &ci);
+
+   /// @brief captures and promotions only, for quiescence search and ProbCut
+   MovePicker(SearchThread &st, Move ttMove);
+
+   /// @brief the next move to search
+   /// @param skipQuiets jump over the quiet stages, they can still come from the TT
+   /// @return NO_MOVE once every stage is exhausted
+   Move next(bool skipQuiets = false);
+
+   /// @brief the move last returned lost material by SEE
+   bool badCapture() const { return stage == BAD_CAPTURES || stage == QS_BAD_CAPTURES; }
+
+ private:
+   SearchThread &st;
+   Board &board;
+   SearchStack *ss;
+   // Only set for the main search, quiescence never scores quiets
+   const CheckInfo *checkInfo;
+   Move ttMove;
+   Move killers[2];
+   uint8_t stage;
+
+   Movelist captures;
+   Movelist quiets;
+   Movelist badCaptures;
+   int current = 0;
+
+   /// @brief best remaining move of a list other than the TT move and killers,
+   /// NO_MOVE once the list is used up
+   Move selectNext(Movelist &list);
+
+   bool usableKiller(Move move);
+
+   bool isKiller(Move move) const { return move == killers[0] || move == killers[1]; }
+};
@@ -0,0 +1,228 @@
+#include "nnue.hpp"
+#include <algorithm>
+#include <fstream>
+#include <memory>
+
+namespace NNUE
+{
+   static Weights weights;
+   static bool loaded = false;
+
+   bool load(const std::string &path)
+   {
+      std::ifstream file(path, std::ios::binary);
+      if (!file)
+         return false;
+
+      constexpr std::streamsize expected =
+          (INPUT_SIZE * HIDDEN_SIZE + HIDDEN_SIZE + 1) * sizeof(int16_t) + 2 * HIDDEN_SIZE * sizeof(int8_t);
+
+      file.seekg(0, std::ios::end);
+      if (file.tellg() != expected)
+         return false;
+      file.seekg(0, std::ios::beg);
+
+      // Read into a scratch copy so a broken file cannot leave a half loaded net behind
+      auto net = std::make_unique<Weights>();
+      file.read(reinterpret_cast<char *>(net->featureWeights), sizeof(net->featureWeights));
+      file.read(reinterpret_cast<char *>(net->featureBias), sizeof(net->featureBias));
+      file.read(reinterpret_cast<char *>(net->outputWeights), sizeof(net->outputWeights));
+      file.read(reinterpret_cast<char *>(&net->outputBias), sizeof(net->outputBias));
+
+      if (!file)
+         return false;
+
+      weights = *net;
+      loaded = true;
+      return true;
+   }
+
+   void unload() { loaded = false; }
+
+   bool isLoaded() { return loaded; }
+
+   // *******************
+   // Kernels
+   // *******************
+
+   static inline int featureIndex(Color perspective, Piece piece, Square sq)
+   {
+      const Color color = Color(piece / 6);
+      const int type = piece % 6;
+      const int relativeSq = perspective == White ? sq : sq ^ 56;
+      return ((color != perspective) * 6 + type) * 64 + relativeSq;
+   }
+
+   static inline const int16_t *featureRow(Color perspective, Piece piece, Square sq)
+   {
+      return &weights.featureWeights[featureIndex(perspective, piece, sq) * HIDDEN_SIZE];
+   }
+
+   static inline void addRow(int16_t *acc, const int16_t *row)
+   {
+#if defined(__AVX2__)
+      for (int i = 0; i < HIDDEN_SIZE; i += 16)
+      {
+         const __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i *>(acc + i));
+         const __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i *>(row + i));
+         _mm256_store_si256(reinterpret_cast<__m256i *>(acc + i), _mm256_add_epi16(a, w));
+      }
+#elif defined(__SSE4_1__)
+      for (int i = 0; i < HIDDEN_SIZE; i += 8)
+      {
+         const __m128i a = _mm_load_si128(reinterpret_cast<const __m128i *>(acc + i));
+         const __m128i w = _mm_load_si128(reinterpret_cast<const __m128i *>(row + i));
+         _mm_store_si128(reinterpret_cast<__m128i *>(acc + i), _mm_add_epi16(a, w));
+      }
+#else
+      for (int i = 0; i < HIDDEN_SIZE; i++)
+         acc[i] += row[i];
+#endif
+   }
+
+   static inline void subRow(int16_t *acc, const int16_t *row)
+   {
+#if defined(__AVX2__)
+      for (int i = 0; i < HIDDEN_SIZE; i += 16)
+      {
+         const __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i *>(acc + i));
+         const __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i *>(row + i));
+         _mm256_store_si256(reinterpret_cast<__m256i *>(acc + i), _mm256_sub_epi16(a, w));
+      }
+#elif defined(__SSE4_1__)
+      for (int i = 0; i < HIDDEN_SIZE; i += 8)
+      {
+         const __m128i a = _mm_load_si128(reinterpret_cast<const __m128i *>(acc + i));
+         const __m128i w = _mm_load_si128(reinterpret_cast<const __m128i *>(row + i));
+         _mm_store_si128(reinterpret_cast<__m128i *>(acc + i), _mm_sub_epi16(a, w));
+      }
+#else
+      for (int i = 0; i < HIDDEN_SIZE; i++)
+         acc[i] -= row[i];
+#endif
+   }
+
+   /// @brief sum of clamp(acc, 0, QA) * weights over one half of the hidden layer.
+   /// The activations are packed to uint8 and multiplied with the int8 weights,
+   /// every pair of products fits in int16 because QA * 127 * 2 < 32768.
+   static inline int32_t clippedDot(const int16_t *acc, const int8_t *w)
+   {
+#if defined(__AVX2__)
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i qa = _mm256_set1_epi16(QA);
+      const __m256i ones = _mm256_set1_epi16(1);
+      __m256i sum = _mm256_setzero_si256();
+
+      for (int i = 0; i < HIDDEN_SIZE; i += 32)
+      {
+         __m256i lo = _mm256_load_si256(reinterpret_cast<const __m256i *>(acc + i));
+         __m256i hi = _mm256_load_si256(reinterpret_cast<const __m256i *>(acc + i + 16));
+         lo = _mm256_min_epi16(_mm256_max_epi16(lo, zero), qa);
+         hi = _mm256_min_epi16(_mm256_max_epi16(hi, zero), qa);
+
+         // packus interleaves the 128 bit lanes, put the 32 activations back in order
+         const __m256i act = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+         const __m256i weight = _mm256_load_si256(reinterpret_cast<const __m256i *>(w + i));
+         sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(act, weight), ones));
+      }
+
+      __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+      s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+      s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+      return _mm_cvtsi128_si32(s);
+#elif defined(__SSE4_1__)
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i qa = _mm_set1_epi16(QA);
+      const __m128i ones = _mm_set1_epi16(1);
+      __m128i sum = _mm_setzero_si128();
+
+      for (int i = 0; i < HIDDEN_SIZE; i += 16)
+      {
+         __m128i lo = _mm_load_si128(reinterpret_cast<const __m128i *>(acc + i));
+         __m128i hi = _mm_load_si128(reinterpret_cast<const __m128i *>(acc + i + 8));
+         lo = _mm_min_epi16(_mm_max_epi16(lo, zero), qa);
+         hi = _mm_min_epi16(_mm_max_epi16(hi, zero), qa);
+
+         const __m128i act = _mm_packus_epi16(lo, hi);
+         const __m128i weight = _mm_load_si128(reinterpret_cast<const __m128i *>(w + i));
+         sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(act, weight), ones));
+      }
+
+      sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+      sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+      return _mm_cvtsi128_si32(sum);
+#else
+      int32_t sum = 0;
+      for (int i = 0; i < HIDDEN_SIZE; i++)
+         sum += std::clamp<int32_t>(acc[i], 0, QA) * w[i];
+      return sum;
+#endif
+   }
+
+   // *******************
+   // Accumulator stack
+   // *******************
+
+   void Net::refresh(const Board &board, Accumulator &acc)
+   {
+      for (Color perspective : {White, Black})
+      {
+         std::copy(std::begin(weights.featureBias), std::end(weights.featureBias), acc.values[perspective]);
+
+         U64 occupied = board.All();
+         while (occupied)
+         {
+            const Square sq = static_cast<Square>(pop_lsb(occupied));
+            addRow(acc.values[perspective], featureRow(perspective, board.pieceAtB(sq), sq));
+         }
+      }
+   }
+
+   void Net::update(int ply)
+   {
+      Accumulator &acc = accumulators[ply];
+      acc = accumulators[ply - 1];
+
+      for (int i = 0; i < dirtyCount[ply]; i++)
+      {
+         const DirtyPiece &dp = dirty[ply][i];
+
+         for (Color perspective : {White, Black})
+         {
+            if (dp.from != NO_SQ)
+               subRow(acc.values[perspective], featureRow(perspective, dp.piece, dp.from));
+            if (dp.to != NO_SQ)
+               addRow(acc.values[perspective], featureRow(perspective, dp.piece, dp.to));
+         }
+      }
+
+      computed[ply] = true;
+   }
+
+   int Net::evaluate(const Board &board)
+   {
+      // Walk back to the closest accumulator that is up to date
+      int last = index;
+      while (last > 0 && !computed[last])
+         last--;
+
+      if (computed[last])
+      {
+         for (int ply = last + 1; ply <= index; ply++)
+            update(ply);
+      }
+      else
+      {
+         refresh(board, accumulators[index]);
+         computed[index] = true;
+      }
+
+      const Accumulator &acc = accumulators[index];
+      const Color stm = board.sideToMove;
+
+      int32_t output = clippedDot(acc.values[stm], weights.outputWeights) +
+                       clippedDot(acc.values[~stm], weights.outputWeights + HIDDEN_SIZE);
+
+      return static_cast<int>((int64_t(output) + weights.outputBias) * EVAL_SCALE / (QA * QB));
+   }
+}
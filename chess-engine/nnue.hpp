@@ -0,0 +1,116 @@
+#pragma once
+
+#include "chess.hpp"
+#include <string>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+namespace NNUE
+{
+   using namespace Chess;
+
+   // *******************
+   // Network layout
+   // *******************
+
+   // (768 -> HIDDEN_SIZE) x 2 -> 1, clipped ReLU on the hidden layer.
+   // One input per (piece colour relative to the perspective, piece type, square),
+   // Black's perspective sees the board flipped vertically.
+   //
+   // The accumulator is int16. The clipped activations fit in uint8 and the output
+   // weights are int8, so the output layer runs as an int8 dot product.
+   //
+   // Net files are raw little endian values in this order:
+   //   int16 featureWeights[INPUT_SIZE][HIDDEN_SIZE]
+   //   int16 featureBias[HIDDEN_SIZE]
+   //   int8  outputWeights[2 * HIDDEN_SIZE]   side to move first, then the other side
+   //   int16 outputBias
+   constexpr int INPUT_SIZE = 768;
+   constexpr int HIDDEN_SIZE = 256;
+
+   // Quantisation of the hidden layer, the output layer and the final scale to centipawns.
+   // QA keeps a pair of activation * weight products inside int16 for the int8 kernels.
+   constexpr int QA = 127;
+   constexpr int QB = 64;
+   constexpr int EVAL_SCALE = 400;
+
+   struct Weights
+   {
+      alignas(64) int16_t featureWeights[INPUT_SIZE * HIDDEN_SIZE];
+      alignas(64) int16_t featureBias[HIDDEN_SIZE];
+      alignas(64) int8_t outputWeights[2 * HIDDEN_SIZE];
+      int16_t outputBias;
+   };
+
+   /// @brief loads a net file, the previous net stays active if this fails
+   /// @param path
+   /// @return true if the file had the expected size and was read completely
+   bool load(const std::string &path);
+
+   /// @brief go back to the handcrafted evaluation
+   void unload();
+
+   bool isLoaded();
+
+   // ProbCut re-searches a move without advancing the search ply,
+   // so the stack can run ahead of the ply it was pushed at
+   constexpr int STACK_SIZE = 2 * MAX_PLY;
+
+   struct alignas(64) Accumulator
+   {
+      int16_t values[2][HIDDEN_SIZE];
+   };
+
+   /// @brief a piece added (from == NO_SQ), removed (to == NO_SQ) or moved by a move
+   struct DirtyPiece
+   {
+      Piece piece;
+      Square from;
+      Square to;
+   };
+
+   /// @brief Per thread accumulator stack, one entry per ply.
+   /// Moves only record which pieces changed. The accumulator itself is brought
+   /// up to date from the closest computed ancestor when a position is evaluated,
+   /// so nodes that are never evaluated never pay for an update.
+   struct Net
+   {
+      Accumulator accumulators[STACK_SIZE];
+      DirtyPiece dirty[STACK_SIZE][4];
+      uint8_t dirtyCount[STACK_SIZE];
+      bool computed[STACK_SIZE];
+      int index = 0;
+
+      /// @brief forget every accumulator, the next evaluation refreshes from the board
+      void reset()
+      {
+         index = 0;
+         dirtyCount[0] = 0;
+         computed[0] = false;
+      }
+
+      void push()
+      {
+         index++;
+         assert(index < STACK_SIZE);
+         dirtyCount[index] = 0;
+         computed[index] = false;
+      }
+
+      void pop() { index--; }
+
+      void add(Piece piece, Square sq) { dirty[index][dirtyCount[index]++] = {piece, NO_SQ, sq}; }
+      void remove(Piece piece, Square sq) { dirty[index][dirtyCount[index]++] = {piece, sq, NO_SQ}; }
+      void move(Piece piece, Square from, Square to) { dirty[index][dirtyCount[index]++] = {piece, from, to}; }
+
+      /// @brief network output in centipawns from the side to move's point of view
+      /// @param board the position at the top of the stack
+      int evaluate(const Board &board);
+
+   private:
+      void refresh(const Board &board, Accumulator &acc);
+      void update(int ply);
+   };
+}
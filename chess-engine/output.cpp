@@ -0,0 +1,60 @@
+#include "output.hpp"
+#include <iostream>
+
+OutputWriter output;
+
+OutputWriter::OutputWriter() : writer([this] { run(); }) {}
+
+OutputWriter::~OutputWriter()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = true;
+   }
+   wake.notify_one();
+   writer.join();
+}
+
+void OutputWriter::send(std::string line)
+{
+   line += '\n';
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending.push_back(std::move(line));
+   }
+   wake.notify_one();
+}
+
+void OutputWriter::flush()
+{
+   std::unique_lock<std::mutex> lock(mutex);
+   drained.wait(lock, [this] { return pending.empty() && !writing; });
+}
+
+void OutputWriter::run()
+{
+   std::deque<std::string> batch;
+   std::unique_lock<std::mutex> lock(mutex);
+
+   while (true)
+   {
+      wake.wait(lock, [this] { return quit || !pending.empty(); });
+
+      // Everything queued is written before shutting down
+      if (pending.empty())
+         break;
+
+      batch.swap(pending);
+      writing = true;
+      lock.unlock();
+
+      for (const std::string &line : batch)
+         std::cout << line;
+      std::cout.flush();
+      batch.clear();
+
+      lock.lock();
+      writing = false;
+      drained.notify_all();
+   }
+}
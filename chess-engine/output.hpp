@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/// @brief Queue for everything the search reports to the GUI. Lines are written
+/// by a thread of their own, so a GUI that is slow to read never holds up a
+/// search thread. Lines come out in the order they were sent.
+class OutputWriter
+{
+ public:
+   OutputWriter();
+   ~OutputWriter();
+
+   OutputWriter(const OutputWriter &) = delete;
+   OutputWriter &operator=(const OutputWriter &) = delete;
+
+   /// @brief queues one line, the newline is added here
+   void send(std::string line);
+
+   /// @brief blocks until every line sent so far has been written
+   void flush();
+
+ private:
+   void run();
+
+   std::mutex mutex;
+   std::condition_variable wake;
+   std::condition_variable drained;
+   std::deque<std::string> pending;
+   bool writing = false;
+   bool quit = false;
+   std::thread writer;
+};
+
+extern OutputWriter output;
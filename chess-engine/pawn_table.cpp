@@ -0,0 +1,26 @@
+#include "pawn_table.hpp"
+#include "evaluate_features.hpp"
+
+void PawnTable::Initialize(int MB)
+{
+    entries.clear();
+    entries.resize((MB * 1024 * 1024) / sizeof(PawnEntry), PawnEntry());
+}
+
+const PawnEntry &PawnTable::probe(const Board &board)
+{
+    PawnEntry &entry = entries[reduce_hash(board.pawnKey, entries.size())];
+
+    if (entry.key != board.pawnKey || !entry.key)
+    {
+        evaluatePawns(board, entry);
+        entry.key = board.pawnKey;
+    }
+
+    return entry;
+}
+
+void PawnTable::clear()
+{
+    std::fill(entries.begin(), entries.end(), PawnEntry());
+}
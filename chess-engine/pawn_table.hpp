@@ -0,0 +1,37 @@
+#pragma once
+
+#include "types.hpp"
+#include <vector>
+
+// 1 MB per thread by default
+#define DEFAULT_PAWNHASH 1
+#define MAXPAWNHASH 256
+
+// Everything the evaluator derives from the pawn structure alone.
+// Only valid while the board's pawnKey matches key.
+struct PawnEntry {
+    U64 key = 0;
+
+    // Pawn-only structure score from White's perspective
+    int16_t score = 0;
+
+    U64 passedPawns[2] = {};
+
+    // Squares attacked by pawns right now
+    U64 pawnAttacks[2] = {};
+};
+
+class PawnTable {
+  private:
+    std::vector<PawnEntry> entries;
+
+  public:
+    PawnTable(int MB = DEFAULT_PAWNHASH) { Initialize(MB); }
+
+    void Initialize(int MB);
+
+    // Returns the entry for the board's pawn structure, evaluating it on a miss
+    const PawnEntry &probe(const Board &board);
+
+    void clear();
+};
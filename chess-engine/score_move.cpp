@@ -1,5 +1,9 @@
 #include "score_move.hpp"
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 static inline int getContinuationHistoryScores(SearchThread &st, SearchStack *ss,
                                                const Move &move)
 {
@@ -19,69 +23,30 @@ static inline int getContinuationHistoryScores(SearchThread &st, SearchStack *ss
     return score;
 }
 
-// Move scoring
-void scoreMoves(SearchThread &st, Movelist &list, SearchStack *ss, Move tt_move)
+int scoreCapture(const Board &board, Move move)
 {
+    const Piece attacker = board.pieceAtB(from(move));
+    Piece victim = board.pieceAtB(to(move));
 
-    // Loop through moves in movelist.
-    for (int i = 0; i < list.size; i++)
-    {
-        Piece victim = st.board.pieceAtB(to(list[i].move));
-        Piece attacker = st.board.pieceAtB(from(list[i].move));
+    // En passant is the only pawn move without a piece on the target square
+    if (victim == None && piece(move) == PAWN && !promoted(move) && square_file(from(move)) != square_file(to(move)))
+        victim = board.sideToMove == White ? BlackPawn : WhitePawn;
 
-        // Score tt move the highest
-        if (list[i].move == tt_move)
-        {
-            list[i].value = PvMoveScore;
-        }
-        else if (victim != None)
-        {
-            // If it's a capture move, we score using MVVLVA (Most valuable
-            // victim, Least Valuable Attacker) and if see move that doesn't
-            // lose material, we add additional bonus
+    // Most valuable victim, least valuable attacker. Queen promotions go first.
+    int score = victim != None ? mvv_lva[attacker][victim] : 0;
+    if (promoted(move) && piece(move) == QUEEN)
+        score += QueenPromotionScore;
 
-            list[i].value = mvv_lva[attacker][victim] +
-                            (GoodCaptureScore * see(st.board, list[i].move, -107));
-        }
-        else if (list[i].move == ss->killers[0])
-        {
-            // Score for killer 1
-            list[i].value = Killer1Score;
-        }
-        else if (list[i].move == ss->killers[1])
-        {
-            // Score for killer 2
-            list[i].value = Killer2Score;
-        }
-        else
-        {
-            // Otherwise, history score.
-            list[i].value = st.searchHistory[attacker][to(list[i].move)] + getContinuationHistoryScores(st, ss, list[i].move);
-        }
-    }
+    return score;
 }
 
-// Used for Qsearch move scoring
-void scoreMovesForQS(Board &board, Movelist &list, Move tt_move)
+int scoreQuiet(SearchThread &st, SearchStack *ss, Move move, const CheckInfo &ci)
 {
-
-    // Loop through moves in movelist.
-    for (int i = 0; i < list.size; i++)
-    {
-        Piece victim = board.pieceAtB(to(list[i].move));
-        Piece attacker = board.pieceAtB(from(list[i].move));
-        if (list[i].move == tt_move)
-        {
-            list[i].value = PvMoveScore;
-        }
-        else if (victim != None)
-        {
-            // If it's a capture move, we score using MVVLVA (Most valuable
-            // victim, Least Valuable Attacker)
-            list[i].value = mvv_lva[attacker][victim] +
-                            (GoodCaptureScore * see(board, list[i].move, -107));
-        }
-    }
+    const Piece moved = st.board.pieceAtB(from(move));
+    int score = st.searchHistory[moved][to(move)] + getContinuationHistoryScores(st, ss, move);
+    if (st.board.givesCheck(ci, move))
+        score += QuietCheckBonus;
+    return score;
 }
 
 void pickNextMove(const int& moveNum, Movelist &list)
@@ -107,6 +72,52 @@ void pickNextMove(const int& moveNum, Movelist &list)
     list[bestnum] = temp;
 }
 
+/* Keeps about 3/4 of every score. The quarter taken off is rounded up and away
+   from zero, so scores of either sign shrink every time and small ones reach zero */
+static void decayHistory(int16_t *values, size_t count)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i three = _mm256_set1_epi16(3);
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+        const __m256i sign = _mm256_srai_epi16(v, 15);
+        // (|v| + 3) / 4, then given the sign of v again
+        __m256i quarter = _mm256_srli_epi16(_mm256_add_epi16(_mm256_abs_epi16(v), three), 2);
+        quarter = _mm256_sub_epi16(_mm256_xor_si256(quarter, sign), sign);
+        v = _mm256_sub_epi16(v, quarter);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(values + i), v);
+    }
+#elif defined(__SSE2__)
+    const __m128i three = _mm_set1_epi16(3);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i));
+        const __m128i sign = _mm_srai_epi16(v, 15);
+        // (|v| + 3) / 4, then given the sign of v again
+        const __m128i abs = _mm_sub_epi16(_mm_xor_si128(v, sign), sign);
+        __m128i quarter = _mm_srli_epi16(_mm_add_epi16(abs, three), 2);
+        quarter = _mm_sub_epi16(_mm_xor_si128(quarter, sign), sign);
+        v = _mm_sub_epi16(v, quarter);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(values + i), v);
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        const int quarter = (std::abs(values[i]) + 3) >> 2;
+        values[i] -= values[i] < 0 ? -quarter : quarter;
+    }
+}
+
+void SearchThread::ageHistories()
+{
+    decayHistory(searchHistory[0].data(), sizeof(searchHistory) / sizeof(int16_t));
+    decayHistory(continuationHistory[0][0][0].data(), sizeof(continuationHistory) / sizeof(int16_t));
+}
+
 void updateH(int16_t &historyScore, const int bonus)
 {
     historyScore += bonus - historyScore * std::abs(bonus) / MAXHISTORY;
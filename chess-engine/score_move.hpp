@@ -18,8 +18,19 @@ constexpr int mvv_lva[12][12] = {
    100, 200, 300, 400, 500, 600, 100, 200, 300, 400, 500, 600
 };
 
-void scoreMoves(SearchThread& st, Movelist &moves, SearchStack *ss, Move tt_move);
-void scoreMovesForQS(Board &board, Movelist &moves, Move tt_move);
+// Sorts queen promotions ahead of every capture
+constexpr int QueenPromotionScore = 1000;
+
+// Lifts quiet checks above quiets with an average history
+constexpr int QuietCheckBonus = 16000;
+
+/// @brief MVV-LVA order of a capture or promotion
+int scoreCapture(const Board &board, Move move);
+
+/// @brief history and continuation history of a quiet move, plus a bonus when it gives check
+/// @param ci checkInfo() of the position
+int scoreQuiet(SearchThread &st, SearchStack *ss, Move move, const CheckInfo &ci);
+
 void pickNextMove(const int& index, Movelist &moves);
 void updateContinuationHistories(SearchStack* ss, Piece piece, Move move, int bonus);
 void updateHistories(SearchThread& st, SearchStack *ss, Move bestmove, Movelist &quietList, int depth);
@@ -1,6 +1,8 @@
 #include "search.hpp"
 #include "tunable_params.hpp" // Make sure to include this
 #include "score_move.hpp"
+#include "movepicker.hpp"
+#include "output.hpp"
 
 int lmrTable[MAXDEPTH][NSQUARES] = {{0}};
 int lmpTable[2][8] = {{0}};
@@ -38,13 +40,6 @@ void initLateMoveTable()
       lmpTable[1][depth] = 4.0 + 4 * depth * depth / 4.5;
    }
 }
-bool gives_check(Board &board, Move move)
-{
-   board.makeMove(move);
-   bool check = board.isSquareAttacked(~board.sideToMove, board.KingSQ(board.sideToMove));
-   board.unmakeMove(move);
-   return check;
-}
 int score_to_tt(int score, int ply)
 {
    if (score >= IS_MATE_IN_MAX_PLY)
@@ -77,11 +72,72 @@ int score_from_tt(int score, int ply)
    return score;
 }
 
+/* Static evaluation, looked up in the shared eval cache before running the evaluator */
+template <Color c>
+static int staticEval(SearchThread &st)
+{
+   int eval;
+   if (evalCache->probe(st.board.hashKey, eval))
+      return eval;
+
+   if (NNUE::isLoaded())
+      eval = std::clamp(st.nnue.evaluate(st.board), IS_MATED_IN_MAX_PLY + 1, IS_MATE_IN_MAX_PLY - 1);
+   else
+      eval = evaluate<c>(st.board, st.pawnTable);
+
+   evalCache->store(st.board.hashKey, eval);
+   return eval;
+}
+
+// Root moves are announced once a search has run this long
+static constexpr Time CURRMOVE_DELAY = 3000 * MILLISECOND;
+
+/* Score in UCI terms, mates are counted in moves and negative when we are mated */
+static std::string uciScore(int score)
+{
+   if (score >= IS_MATE_IN_MAX_PLY)
+      return "mate " + std::to_string((ISMATE - score + 1) / 2);
+   if (score <= IS_MATED_IN_MAX_PLY)
+      return "mate " + std::to_string(-(ISMATE + score) / 2);
+   return "cp " + std::to_string(score);
+}
+
+/* One UCI info line for a search result, bound is "lowerbound", "upperbound" or empty for an exact score */
+static void reportLine(SearchThread &st, int depth, int multiPV, const PvLine &line, const char *bound)
+{
+   const Time elapsed = misc::now() - st.start_time();
+   const uint64_t nodes = st.info.pool ? st.info.pool->nodes() : st.nodeCount();
+
+   std::string text = "info depth " + std::to_string(depth);
+   text += " seldepth " + std::to_string(st.seldepth);
+   text += " multipv " + std::to_string(multiPV);
+   text += " score " + uciScore(line.score);
+   if (*bound)
+      text += std::string(" ") + bound;
+   text += " nodes " + std::to_string(nodes);
+   text += " nps " + std::to_string(nodes * 1000 * MILLISECOND / std::max<Time>(1, elapsed));
+   text += " hashfull " + std::to_string(table->hashfull());
+   text += " tbhits 0";
+   text += " time " + std::to_string(elapsed / MILLISECOND);
+   text += " pv";
+   for (int ply = 0; ply < line.length; ply++)
+      text += " " + convertMoveToUci(line.moves[ply]);
+
+   output.send(std::move(text));
+}
+
+template <NodeType nodeType, Color c>
 int quiescence(int alpha, int beta, SearchThread &st, SearchStack *ss)
 {
-   st.nodes++;
+   static_assert(nodeType != Root, "the root is never searched by quiescence");
+   constexpr bool isPVNode = nodeType == PV;
+
+   const uint64_t nodes = st.countNode();
+   st.pvLength[ss->ply] = ss->ply;
+   st.seldepth = std::max(st.seldepth, ss->ply + 1);
+   st.stats.add(STAT_QNODES);
    /* Checking for time every 2048 nodes */
-   if (!(st.nodes & 2047))
+   if (!(nodes & 2047))
    {
       st.check_time();
    }
@@ -89,28 +145,18 @@ int quiescence(int alpha, int beta, SearchThread &st, SearchStack *ss)
    Board &board = st.board;
    if (ss->ply > MAXPLY - 1)
    {
-      return evaluate(board);
+      return staticEval<c>(st);
    }
    if (board.isRepetition())
    {
       return 0;
    }
-   int standPat = evaluate(board);
-   if (standPat >= beta)
-      return beta;
-
-   // Futility pruning in quiescence search
-   // If our standing pat plus a maximum gain doesn't reach alpha, we can skip the search
-   const int futilityMargin = TunableParams::QS_FUTILITY_MARGIN; // Was hardcoded as 177
-   if (standPat + futilityMargin < alpha)
-      return alpha;
-
-   if (standPat > alpha)
-      alpha = standPat;
    /* Probe Tranpsosition Table */
    bool ttHit = false;
-   bool isPVNode = (beta - alpha) > 1;
-   TTEntry &ttEntry = table->probe_entry(board.hashKey, ttHit);
+   const TTEntry ttEntry = table->probe_entry(board.hashKey, ttHit);
+   st.stats.add(STAT_QS_TT_PROBES);
+   if (ttHit)
+      st.stats.add(STAT_QS_TT_HITS);
 
    const int ttScore = ttHit ? score_from_tt(ttEntry.get_score(), ss->ply) : 0;
 
@@ -122,38 +168,46 @@ int quiescence(int alpha, int beta, SearchThread &st, SearchStack *ss)
          return ttScore;
    }
 
+   /* The TT already holds the static eval of any position it has seen */
+   int standPat = ttHit ? ttEntry.get_eval() : staticEval<c>(st);
+   if (standPat >= beta)
+      return beta;
+
+   // Futility pruning in quiescence search
+   // If our standing pat plus a maximum gain doesn't reach alpha, we can skip the search
+   const int futilityMargin = TunableParams::QS_FUTILITY_MARGIN; // Was hardcoded as 177
+   if (standPat + futilityMargin < alpha)
+      return alpha;
+
+   if (standPat > alpha)
+      alpha = standPat;
+
    int bestScore = standPat;
    int moveCount = 0;
    int score = -INF_BOUND;
    Move bestMove = NO_MOVE;
 
-   Movelist captures;
-   if (board.sideToMove == White)
-      Movegen::legalmoves<White, CAPTURE>(board, captures);
-   else
-      Movegen::legalmoves<Black, CAPTURE>(board, captures);
-
-   scoreMovesForQS(st.board, captures, ttEntry.move);
+   MovePicker<c> picker(st, ttEntry.move);
+   Move move;
 
-   for (int i = 0; i < captures.size; i++)
+   while ((move = picker.next()) != NO_MOVE)
    {
-      pickNextMove(i, captures);
-      Move move = captures[i].move;
       ss->movedPice = st.board.pieceAtB(to(move));
 
       /* SEE pruning in quiescence search */
-      /* If we do not SEE a good capture move, we can skip the move.*/
-      if (captures[i].value < GoodCaptureScore && moveCount >= 1)
+      /* Once the good captures are used up, the rest do not need searching.*/
+      if (picker.badCapture() && moveCount >= 1)
       {
-         continue;
+         break;
       }
 
       // Futility pruning for each move
       // If the piece we're capturing plus our current standing pat won't exceed alpha, skip
-      if (moveCount > 0 && !board.isSquareAttacked(~board.sideToMove, board.KingSQ(board.sideToMove)))
+      if (moveCount > 0 && !board.isSquareAttacked(~c, board.KingSQ(c)))
       {
-         // Get the captured piece value
-         int capturedValue = PIECE_VALUES[board.pieceAtB(to(move))];
+         // Get the captured piece value, the target square is empty only for en passant
+         const Piece captured = board.pieceAtB(to(move));
+         int capturedValue = captured == None ? PAWN_VALUE : PIECE_VALUES[type_of_piece(captured)];
 
          // If capturing the best piece possible doesn't bring us above alpha, skip
          if (standPat + capturedValue + TunableParams::QS_FUTILITY_MARGIN < alpha) // Was hardcoded as 140
@@ -162,17 +216,17 @@ int quiescence(int alpha, int beta, SearchThread &st, SearchStack *ss)
 
       ss->continuationHistory = &st.continuationHistory[ss->movedPice][to(move)];
 
-      board.makeMove(move);
+      board.makeMove<c, true>(move);
       table->prefetch_tt(board.hashKey);
 
       (ss + 1)->ply = ss->ply + 1;
       moveCount++;
       ss->move = move;
 
-      score = -quiescence(-beta, -alpha, st, ss + 1);
-      board.unmakeMove(move);
+      score = -quiescence<nodeType, ~c>(-beta, -alpha, st, ss + 1);
+      board.unmakeMove<c, true>(move);
       /* Return 0 if time is up */
-      if (st.info.stopped)
+      if (st.info.stopped.load(std::memory_order_relaxed))
       {
          return 0;
       }
@@ -202,14 +256,23 @@ int quiescence(int alpha, int beta, SearchThread &st, SearchStack *ss)
    return bestScore;
 }
 
+template <NodeType nodeType, Color c>
 int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, bool cutnode)
 {
-   st.nodes++;
+   constexpr bool isRoot = nodeType == Root;
+   constexpr bool isPVNode = nodeType != NonPV;
+
+   const uint64_t nodes = st.countNode();
+   st.pvLength[ss->ply] = ss->ply;
+   st.seldepth = std::max(st.seldepth, ss->ply + 1);
    // Step 1: run quiescence search if depth <=0
    if (depth <= 0)
-      return quiescence(alpha, beta, st, ss);
+      return quiescence<isPVNode ? PV : NonPV, c>(alpha, beta, st, ss);
+
+   st.stats.add(STAT_NODES);
+   st.stats.node(depth);
    /* Checking for time every 2048 nodes */
-   if ((st.nodes & 2047) == 0)
+   if ((nodes & 2047) == 0)
    {
       st.check_time();
    }
@@ -217,9 +280,7 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
    // Step 2: Helper variables
    Board &board = st.board;
 
-   bool isRoot = (ss->ply == 0);
-   bool inCheck = board.isSquareAttacked(~board.sideToMove, board.KingSQ(board.sideToMove));
-   bool isPVNode = (beta - alpha) > 1;
+   bool inCheck = board.isSquareAttacked(~c, board.KingSQ(c));
 
    bool improving = false;
    int eval = 0;
@@ -230,7 +291,7 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
       /* We return static evaluation if we exceed max depth.*/
       if (ss->ply > MAXPLY - 1)
       {
-         return evaluate(board);
+         return staticEval<c>(st);
       }
 
       /* Repetition check*/
@@ -254,7 +315,10 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
 
    // Step 4: TT lookup
    bool ttHit = false;
-   TTEntry &ttEntry = table->probe_entry(board.hashKey, ttHit);
+   const TTEntry ttEntry = table->probe_entry(board.hashKey, ttHit);
+   st.stats.add(isPVNode ? STAT_TT_PROBES_PV : STAT_TT_PROBES_NONPV);
+   if (ttHit)
+      st.stats.add(isPVNode ? STAT_TT_HITS_PV : STAT_TT_HITS_NONPV);
 
    const int ttScore = ttHit ? score_from_tt(ttEntry.get_score(), ss->ply) : 0;
 
@@ -262,10 +326,15 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
    {
       if ((ttEntry.flag == HFALPHA && ttScore <= alpha) || (ttEntry.flag == HFBETA && ttScore >= beta) ||
           (ttEntry.flag == HFEXACT))
+      {
+         st.stats.add(STAT_TT_CUTOFFS);
          return ttScore;
+      }
    }
-   // Use eval frrom TT if we have a hit
-   ss->staticEval = eval = ttHit ? ttEntry.get_eval() : evaluate(board);
+   // Use eval frrom TT if we have a hit. The raw eval is what goes back into the
+   // TT, so quiescence can reuse it even for positions searched while in check.
+   const int rawEval = ttHit ? ttEntry.get_eval() : staticEval<c>(st);
+   ss->staticEval = eval = rawEval;
 
    // If staticEval is better than 2 ply ago -> improve
    improving = !inCheck && ss->staticEval > (ss - 2)->staticEval;
@@ -299,6 +368,7 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
                   (ss - 1)->staticScore / 400 >=
               beta)
       {
+         st.stats.add(STAT_RFP);
          return eval; // fail soft
       }
 
@@ -307,9 +377,10 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
        * some nodes.
        */
       if (ss->staticEval >= (beta - TunableParams::NMP_MARGIN * improving + TunableParams::RFP_IMPROVING_BONUS) &&
-          board.nonPawnMat(board.sideToMove) && (depth >= TunableParams::NMP_BASE) &&
+          board.nonPawnMat(c) && (depth >= TunableParams::NMP_BASE) &&
           ((ss - 1)->move != NULL_MOVE) && (!ttHit || ttEntry.flag != HFALPHA || eval >= beta))
       {
+         st.stats.add(STAT_NMP_TRIES);
          int R = TunableParams::NMP_BASE;
          // https://www.chessprogramming.org/Null_Move_Pruning_Test_Results
          if (popcount(board.occUs) > 2)
@@ -317,15 +388,15 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
          R = depth / TunableParams::NMP_DIVISION + std::min(3, (eval - beta) / 180);
 
          ss->continuationHistory = &st.continuationHistory[None][0];
-         board.makeNullMove();
+         board.makeNullMove<true>();
          ss->move = NULL_MOVE;
 
          (ss + 1)->ply = ss->ply + 1;
 
-         int score = -negamax(-beta, -beta + 1, depth - R, st, ss + 1, !cutnode);
+         int score = -negamax<NonPV, ~c>(-beta, -beta + 1, depth - R, st, ss + 1, !cutnode);
 
-         board.unmakeNullMove();
-         if (st.info.stopped)
+         board.unmakeNullMove<true>();
+         if (st.info.stopped.load(std::memory_order_relaxed))
          {
             return 0;
          }
@@ -339,6 +410,7 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
                score = beta;
             }
 
+            st.stats.add(STAT_NMP_CUTOFFS);
             return score;
          }
       }
@@ -349,22 +421,17 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
       int rbeta = std::min(beta + 100, ISMATE - MAXPLY - 1);
       if (depth >= 5 && abs(beta) < ISMATE && (!ttHit || eval >= rbeta || ttEntry.depth < depth - 3))
       {
-         Movelist captures;
-         if (board.sideToMove == White)
-            Movegen::legalmoves<White, CAPTURE>(board, captures);
-         else
-            Movegen::legalmoves<Black, CAPTURE>(board, captures);
-         scoreMoves(st, captures, ss, ttEntry.move);
+         st.stats.add(STAT_PROBCUT_TRIES);
+         MovePicker<c> picker(st, NO_MOVE);
+         Move move;
          int score = 0;
-         for (int i = 0; i < captures.size; i++)
+         while ((move = picker.next()) != NO_MOVE)
          {
-            pickNextMove(i, captures);
-            Move move = captures[i].move;
             ss->movedPice = board.pieceAtB(from(move));
 
-            if (captures[i].value < GoodCaptureScore)
+            if (picker.badCapture())
             {
-               continue;
+               break;
             }
 
             if (move == ttEntry.move)
@@ -373,20 +440,21 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
             }
 
             ss->continuationHistory = &st.continuationHistory[ss->movedPice][to(move)];
-            board.makeMove(move);
+            board.makeMove<c, true>(move);
 
-            score = -quiescence(-rbeta, -rbeta + 1, st, ss);
+            score = -quiescence<NonPV, ~c>(-rbeta, -rbeta + 1, st, ss);
 
             if (score >= rbeta)
             {
-               score = -negamax(-rbeta, -rbeta + 1, depth - 4, st, ss, !cutnode);
+               score = -negamax<NonPV, ~c>(-rbeta, -rbeta + 1, depth - 4, st, ss, !cutnode);
             }
 
-            board.unmakeMove(move);
+            board.unmakeMove<c, true>(move);
 
             if (score >= rbeta)
             {
-               table->store(board.hashKey, HFBETA, move, depth - 3, score, ss->staticEval);
+               table->store(board.hashKey, HFBETA, move, depth - 3, score, rawEval);
+               st.stats.add(STAT_PROBCUT_CUTOFFS);
                return score;
             }
          }
@@ -394,7 +462,8 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
       // Razoring
       if (eval - 63 + 182 * depth <= alpha)
       {
-         return quiescence(alpha, beta, st, ss);
+         st.stats.add(STAT_RAZORING);
+         return quiescence<NonPV, c>(alpha, beta, st, ss);
       }
    }
    // Decrease depth if we are in a cut node
@@ -408,30 +477,34 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
    Move bestMove = NO_MOVE;
    bool skipQuietMove = false;
 
-   // Step 6: Generate moves
-   Movelist moves;
-   if (board.sideToMove == White)
-      Movegen::legalmoves<White, ALL>(board, moves);
-   else
-      Movegen::legalmoves<Black, ALL>(board, moves);
+   // Shared by the move ordering and every move of the node, makes each check test a few bitboard lookups
+   const CheckInfo checkInfo = board.checkInfo();
 
-   Movelist quietList;
+   // Step 6: Moves are generated and ordered stage by stage as the loop asks for them
+   MovePicker<c> picker(st, ss, ttEntry.move, checkInfo);
+   Move move;
 
-   // Step 7: Scoring moves for ordering moves
-   scoreMoves(st, moves, ss, ttEntry.move);
+   Movelist quietList;
 
    // Step 9: Iterate through moves
-   for (int i = 0; i < moves.size; i++)
+   while ((move = picker.next(skipQuietMove)) != NO_MOVE)
    {
-      pickNextMove(i, moves);
+      // MultiPV: lines already reported this iteration are not searched again
+      if (isRoot && st.excludedAtRoot(move))
+         continue;
+
+      if (isRoot && st.reporting && misc::now() - st.start_time() > CURRMOVE_DELAY)
+      {
+         output.send("info depth " + std::to_string(depth) + " currmove " + convertMoveToUci(move) +
+                     " currmovenumber " + std::to_string(st.pvIndex + moveCount + 1));
+      }
 
-      Move move = moves[i].move;
       ss->movedPice = board.pieceAtB(from(move));
 
       bool isCapture = is_capture(board, move);
       bool isPromotion = promoted(move);
       bool isQuiet = !isCapture && !isPromotion;
-      bool givesCheck = gives_check(board, move);
+      bool givesCheck = board.givesCheck(checkInfo, move);
       // It is not necessarily the best move, but good enough to refute opponents previous move
       bool refutationMove = (ss->killers[0] == move || ss->killers[1] == move);
 
@@ -449,7 +522,7 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
        * We can prune quiet moves that are not captures or promotions
        * LMP + Continuation History pruning + Futility Pruning + SEE pruning
        */
-      if (!isRoot && bestScore > -ISMATE && board.nonPawnMat(board.sideToMove))
+      if (!isRoot && bestScore > -ISMATE && board.nonPawnMat(c))
       {
 
          // Get precalculated lmr depth from lmrTable
@@ -466,6 +539,7 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
              */
             if (!inCheck && !isPVNode && depth <= TunableParams::LMP_DEPTH_THRESHOLD && quietList.size >= lmpTable[improving][depth])
             {
+               st.stats.add(STAT_LMP);
                skipQuietMove = true;
                continue;
             }
@@ -473,6 +547,7 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
             // Continuation History pruning
             if (lmrDepth < 4 && history < -TunableParams::HISTORY_PRUNING_THRESHOLD * depth && (ss - 1)->staticScore > 0 && counterHist < 0)
             {
+               st.stats.add(STAT_HISTORY_PRUNING);
                skipQuietMove = true;
                continue;
             }
@@ -485,12 +560,14 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
             if (lmrDepth <= TunableParams::FUTILITY_DEPTH && !inCheck &&
                 ss->staticEval + TunableParams::FUTILITY_MARGIN + TunableParams::FUTILITY_IMPROVING * depth <= alpha)
             {
+               st.stats.add(STAT_FUTILITY);
                skipQuietMove = true;
             }
 
             // SEE pruning for quiets
             if (depth <= TunableParams::FUTILITY_DEPTH && !see(board, move, TunableParams::SEE_QUIET_MARGIN_BASE * depth))
             {
+               st.stats.add(STAT_SEE_QUIET);
                continue;
             }
          }
@@ -498,6 +575,7 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
             // SEE pruning for noisy
             if (!see(board, move, TunableParams::SEE_NOISY_MARGIN_BASE * depth * depth))
             {
+               st.stats.add(STAT_SEE_NOISY);
                continue;
             }
       }
@@ -506,13 +584,14 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
       ss->continuationHistory = &st.continuationHistory[ss->movedPice][to(move)];
 
       // Step 11: Make the move
-      board.makeMove(move);
+      board.makeMove<c, true>(move);
       table->prefetch_tt(board.hashKey);
 
       ss->move = move;
       (ss + 1)->ply = ss->ply + 1;
 
       moveCount++;
+      const uint64_t nodesBefore = st.nodeCount();
 
       if (isRoot && depth == 1 && moveCount == 1)
       {
@@ -554,16 +633,20 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
           * extension*/
          reduction = std::min(depth - 1, std::max(1, reduction));
 
-         score = -negamax(-alpha - 1, -alpha, depth - reduction, st, ss + 1, true);
+         score = -negamax<NonPV, ~c>(-alpha - 1, -alpha, depth - reduction, st, ss + 1, true);
 
          /* We do a full depth research if our score beats alpha that maybe promising. */
          doFullSearch = score > alpha && reduction != 1;
+
+         st.stats.add(STAT_LMR_SEARCHES);
+         if (doFullSearch)
+            st.stats.add(STAT_LMR_RESEARCHES);
       }
 
       /* Full depth search on a zero window. */
       if (doFullSearch)
       {
-         score = -negamax(-alpha - 1, -alpha, depth - 1, st, ss + 1, !cutnode);
+         score = -negamax<NonPV, ~c>(-alpha - 1, -alpha, depth - 1, st, ss + 1, !cutnode);
       }
 
       /* Principal Variation Search (PVS)
@@ -574,12 +657,14 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
        */
       if (isPVNode && (moveCount == 1 || (score > alpha && (isRoot || score < beta))))
       {
-         score = -negamax(-beta, -alpha, depth - 1, st, ss + 1, false);
+         score = -negamax<PV, ~c>(-beta, -alpha, depth - 1, st, ss + 1, false);
       }
 
       // Step 13: Unmake the move
-      board.unmakeMove(move);
-      if (st.info.stopped && !isRoot)
+      board.unmakeMove<c, true>(move);
+      if (isRoot)
+         st.rootMoveNodes[from(move)][to(move)] += st.nodeCount() - nodesBefore;
+      if (st.info.stopped.load(std::memory_order_relaxed) && !isRoot)
       {
          return 0;
       }
@@ -594,8 +679,13 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
             alpha = score;
             bestMove = move;
 
+            if (isPVNode)
+               st.updatePv(ss->ply, move);
+
             if (score >= beta)
             {
+               st.stats.cutoff(depth, moveCount == 1);
+
                if (isQuiet)
                {
                   // Update killers
@@ -610,7 +700,7 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
             // clang-format on
          }
       }
-      if (st.info.stopped && isRoot && st.bestMove != NO_MOVE)
+      if (st.info.stopped.load(std::memory_order_relaxed) && isRoot && st.bestMove != NO_MOVE)
       {
          break;
       }
@@ -622,7 +712,9 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
    int flag = bestScore >= beta ? HFBETA : (alpha != oldAlpha) ? HFEXACT
                                                                : HFALPHA;
 
-   table->store(board.hashKey, flag, bestMove, depth, score_to_tt(bestScore, ss->ply), ss->staticEval);
+   // A root searched without its best moves would leave a misleading entry
+   if (!isRoot || st.pvIndex == 0)
+      table->store(board.hashKey, flag, bestMove, depth, score_to_tt(bestScore, ss->ply), rawEval);
 
    if (alpha != oldAlpha)
    {
@@ -632,62 +724,107 @@ int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, b
    return bestScore;
 }
 
+// Helper threads skip some depths so they do not all search the same tree,
+// same staggering as the original Lazy SMP implementation in Stockfish
+static constexpr int SKIP_SIZE[20] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static constexpr int SKIP_PHASE[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
 // Template implementation of iterativeDeepening with printInfo parameter
 template <bool printInfo>
 void iterativeDeepening(SearchThread &st, const int &maxDepth)
 {
    SearchInfo &info = st.info;
-   st.clear();
+   st.newSearch();
+   st.ageHistories();
    st.initialize();
-   table->nextAge();
-
-   int score = 0;
+   st.reporting = printInfo && st.id == 0;
 
-   auto startime = st.start_time();
    Move bestMove = NO_MOVE;
 
+   // Every line needs a root move of its own
+   Movelist rootMoves;
+   Movegen::legalmoves<ALL>(st.board, rootMoves);
+   const int multiPV = st.id == 0 ? std::clamp<int>(info.multiPV, 1, std::max<int>(1, rootMoves.size)) : 1;
+
    for (int depth = 1; depth <= maxDepth; depth++)
    {
-      score = aspirationWindow(score, depth, st, bestMove);
-      if (st.info.stopped || st.stop_early())
+      if (st.id > 0 && depth > 1)
       {
-         break;
+         const int i = (st.id - 1) % 20;
+         if (((depth + SKIP_PHASE[i]) / SKIP_SIZE[i]) % 2)
+            continue;
       }
-      bestMove = st.bestMove;
-      if (info.timeset)
+
+      // Each line gets its own aspiration window around its previous score
+      for (st.pvIndex = 0; st.pvIndex < multiPV; st.pvIndex++)
       {
-         st.tm.update_tm(bestMove);
+         st.seldepth = 0;
+         PvLine &line = st.lines[st.pvIndex];
+         const int score = aspirationWindow(line.score, depth, st, bestMove);
+         if (st.stop_early())
+         {
+            break;
+         }
+
+         line.score = score;
+         line.length = st.pvLength[0];
+         std::copy(st.pvTable[0], st.pvTable[0] + line.length, line.moves);
+
+         if (st.pvIndex == 0)
+         {
+            bestMove = st.bestMove;
+            st.rootScore = score;
+            st.rootMove = bestMove;
+         }
+
+         // The first iterations can end without a PV, e.g. when the only move was assumed best
+         if (line.length == 0 && st.pvIndex == 0 && bestMove != NO_MOVE)
+         {
+            line.moves[0] = bestMove;
+            line.length = 1;
+         }
       }
-      if constexpr (printInfo)
+
+      if (st.stop_early())
       {
-        
-            auto time_elapsed = misc::tick() - startime;
+         break;
+      }
 
+      // Search instability can put a later line above an earlier one
+      std::stable_sort(st.lines, st.lines + multiPV, [](const PvLine &a, const PvLine &b) { return a.score > b.score; });
+      if (st.lines[0].length > 0)
+      {
+         bestMove = st.lines[0].moves[0];
+         st.rootScore = st.lines[0].score;
+         st.rootMove = bestMove;
+      }
+      st.pvIndex = 0;
 
-            std::cout<<"score ";
-            if (score >= ISMATED && score <= IS_MATED_IN_MAX_PLY)
-            {
-               std::cout << "mate " << ((ISMATED - score) / 2);
-            }
-            else if (score >= IS_MATE_IN_MAX_PLY && score <= ISMATE)
-            {
-               std::cout << "mate " << ((ISMATE - score) / 2);
-            }else{
-               std::cout << score;
-            }
-            std::cout << " depth " << depth;
-            std::cout << " nodes " << st.nodes;
-            std::cout << " nps " << static_cast<uint64_t>(st.nodes  / (time_elapsed/1000));
-            std::cout << " time " << static_cast<uint64_t>(time_elapsed);
-            std::cout << std::endl;
-         
-        
+      st.completedDepth = depth;
+      st.stats.iteration(depth, st.info.pool ? st.info.pool->nodes() : st.nodeCount());
+
+      if (info.timeset && st.id == 0)
+      {
+         const uint64_t bestMoveNodes = st.rootMoveNodes[from(bestMove)][to(bestMove)];
+         st.tm.update_tm(bestMove, st.rootScore, static_cast<int>(bestMoveNodes * 1000 / std::max<uint64_t>(1, st.nodeCount())));
+         info.timer.set_soft(st.tm.stoptime_opt);
+      }
+      if constexpr (printInfo)
+      {
+         for (int i = 0; i < multiPV; i++)
+            reportLine(st, depth, i + 1, st.lines[i], "");
       }
    }
 
-   if (printInfo)
+   st.pvIndex = 0;
+
+   // A search cut short before finishing depth 1 still needs a move to play,
+   // even one stopped before it reached the first root move
+   if (st.rootMove == NO_MOVE)
    {
-       std::cout << "bestmove " << convertMoveToUci(bestMove) << std::endl;
+      st.rootMove = bestMove != NO_MOVE ? bestMove : st.bestMove;
+      if (st.rootMove == NO_MOVE && rootMoves.size > 0)
+         st.rootMove = rootMoves[0].move;
    }
 }
 
@@ -701,6 +838,226 @@ void iterativeDeepening(SearchThread &st, const int &maxDepth)
    iterativeDeepening<true>(st, maxDepth);
 }
 
+void ThreadPool::resize(int count)
+{
+   // Helpers hold on to their SearchThread, so they go away while the list changes
+   stopHelpers();
+
+   while (size() > count)
+      threads.pop_back();
+
+   while (size() < count)
+   {
+      threads.push_back(std::make_unique<SearchThread>(info, size()));
+      threads.back()->pawnTable.Initialize(pawnHashMB);
+   }
+
+   startHelpers();
+}
+
+void ThreadPool::startHelpers()
+{
+   // Read here rather than by the new thread, so a search started right away is not missed
+   helpersExit = false;
+   const uint64_t current = generation;
+   for (int i = 1; i < size(); i++)
+      helpers.emplace_back([this, i, current] { helperLoop(i, current); });
+}
+
+void ThreadPool::stopHelpers()
+{
+   {
+      std::lock_guard<std::mutex> lock(helperMutex);
+      helpersExit = true;
+   }
+   helperWake.notify_all();
+
+   for (std::thread &helper : helpers)
+      helper.join();
+   helpers.clear();
+}
+
+void ThreadPool::helperLoop(int index, uint64_t searched)
+{
+   SearchThread &helper = *threads[index];
+
+   std::unique_lock<std::mutex> lock(helperMutex);
+   while (true)
+   {
+      helperWake.wait(lock, [&] { return helpersExit || generation != searched; });
+      if (helpersExit)
+         return;
+
+      searched = generation;
+      const int maxDepth = helperDepth;
+      lock.unlock();
+
+      iterativeDeepening<false>(helper, maxDepth);
+
+      lock.lock();
+      if (--helpersRunning == 0)
+         helpersDone.notify_one();
+   }
+}
+
+void ThreadPool::setPawnHash(int MB)
+{
+   pawnHashMB = MB;
+   for (auto &thread : threads)
+      thread->pawnTable.Initialize(MB);
+}
+
+/* The move we expect the opponent to answer the best move with, the one we ponder on */
+static Move expectedReply(SearchThread &st)
+{
+   const PvLine &pv = st.lines[0];
+   if (pv.length > 1 && pv.moves[0] == st.rootMove)
+      return pv.moves[1];
+
+   // Fail highs and TT cutoffs at the root leave a one move PV, the TT usually still knows the reply
+   if (st.rootMove == NO_MOVE)
+      return NO_MOVE;
+
+   Board board = st.board;
+   board.makeMove(st.rootMove);
+
+   bool ttHit = false;
+   const Move reply = table->probe_entry(board.hashKey, ttHit).move;
+   return ttHit && Movegen::isLegal(board, reply) ? reply : NO_MOVE;
+}
+
+void ThreadPool::search(int maxDepth)
+{
+   SearchThread &mainThread = main();
+   table->nextAge();
+
+   for (int i = 1; i < size(); i++)
+      threads[i]->board = mainThread.board;
+
+   {
+      std::lock_guard<std::mutex> lock(helperMutex);
+      helperDepth = maxDepth;
+      helpersRunning = size() - 1;
+      generation++;
+   }
+   helperWake.notify_all();
+
+   iterativeDeepening<true>(mainThread, maxDepth);
+   info.timer.stop();
+
+   // In infinite mode and while pondering the GUI decides when the search is over
+   {
+      std::unique_lock<std::mutex> lock(releaseMutex);
+      released.wait(lock, [this] { return !(info.infinite || info.pondering) || info.stopped; });
+   }
+
+   info.stopped = true;
+   {
+      std::unique_lock<std::mutex> lock(helperMutex);
+      helpersDone.wait(lock, [this] { return helpersRunning == 0; });
+   }
+
+   // Trust the deepest completed iteration, the score only breaks ties between equal depths.
+   // A deeper result whose score dropped has seen a refutation the shallower ones missed.
+   SearchThread *best = &mainThread;
+   for (auto &thread : threads)
+   {
+      if (thread->rootMove == NO_MOVE)
+         continue;
+
+      if (best->rootMove == NO_MOVE || thread->completedDepth > best->completedDepth ||
+          (thread->completedDepth == best->completedDepth && thread->rootScore > best->rootScore))
+      {
+         best = thread.get();
+      }
+   }
+
+   // Mated or stalemated at the root: UCI's null move, with nothing to ponder on
+   if (best->rootMove == NO_MOVE)
+   {
+      output.send("bestmove 0000");
+   }
+   else
+   {
+      std::string text = "bestmove " + convertMoveToUci(best->rootMove);
+      const Move reply = expectedReply(*best);
+      if (reply != NO_MOVE)
+         text += " ponder " + convertMoveToUci(reply);
+      output.send(std::move(text));
+   }
+
+   if constexpr (SearchStats::enabled)
+      output.send(stats().report());
+}
+
+SearchStats ThreadPool::stats() const
+{
+   // The main thread's copy keeps its iteration history for the branching factor
+   SearchStats total = threads[0]->stats;
+   for (int i = 1; i < size(); i++)
+      total.merge(threads[i]->stats);
+   return total;
+}
+
+void ThreadPool::start(int maxDepth)
+{
+   wait();
+
+   // Armed before the search thread runs, so a quick ponderhit cannot be missed
+   SearchThread &mainThread = main();
+   if (info.timeset)
+   {
+      mainThread.tm.set_time(mainThread.board.sideToMove);
+      info.timer.start(info.stopped, mainThread.tm, info.pondering);
+   }
+
+   searcher = std::thread([this, maxDepth] { search(maxDepth); });
+}
+
+void ThreadPool::wait()
+{
+   if (searcher.joinable())
+      searcher.join();
+}
+
+void ThreadPool::ponderhit()
+{
+   // The clock restarts before the best move can be released
+   info.timer.ponderhit(misc::now());
+   {
+      std::lock_guard<std::mutex> lock(releaseMutex);
+      info.pondering = false;
+   }
+   released.notify_one();
+}
+
+void ThreadPool::stop()
+{
+   {
+      std::lock_guard<std::mutex> lock(releaseMutex);
+      info.stopped = true;
+   }
+   released.notify_one();
+   wait();
+}
+
+void ThreadPool::clear()
+{
+   for (auto &thread : threads)
+   {
+      thread->clear();
+      thread->pawnTable.clear();
+   }
+}
+
+uint64_t ThreadPool::nodes() const
+{
+   uint64_t total = 0;
+   for (const auto &thread : threads)
+      total += thread->nodeCount();
+   return total;
+}
+
 int aspirationWindow(int prevEval, int depth, SearchThread &st, Move &bestmove)
 {
    int score = 0;
@@ -723,11 +1080,22 @@ int aspirationWindow(int prevEval, int depth, SearchThread &st, Move &bestmove)
    while (true)
    {
 
-      score = negamax(alpha, beta, depth, st, ss, false);
+      score = st.board.sideToMove == White ? negamax<Root, White>(alpha, beta, depth, st, ss, false)
+                                           : negamax<Root, Black>(alpha, beta, depth, st, ss, false);
       if (st.stop_early())
       {
          break;
       }
+      // Long searches show the GUI that the window failed
+      if ((score <= alpha || score >= beta) && st.reporting && misc::now() - st.start_time() > CURRMOVE_DELAY)
+      {
+         PvLine line;
+         line.score = score;
+         line.length = st.pvLength[0];
+         std::copy(st.pvTable[0], st.pvTable[0] + line.length, line.moves);
+         reportLine(st, depth, st.pvIndex + 1, line, score <= alpha ? "upperbound" : "lowerbound");
+      }
+
       if (score <= alpha)
       {
          beta = (alpha + beta) / 2;
@@ -4,11 +4,20 @@
 #include "types.hpp"
 #include "evaluate.hpp"
 #include "tt.hpp"
+#include "pawn_table.hpp"
+#include "nnue.hpp"
 #include "see.hpp"
 #include <memory.h>
 #include <algorithm>
 #include <math.h>
 #include "timeman.hpp"
+#include "search_stats.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 using namespace Chess;
 using HistoryTable = std::array<std::array<int16_t, 64>, 13>;
 
@@ -22,15 +31,44 @@ const int NMPBase = 3;
 const int NMPDivision = 3;
 const int NMPMargin = 180;
 
+#define MAXTHREADS 256
+#define MAXMULTIPV 256
+
 extern TranspositionTable *table;
+extern EvalCache *evalCache;
+
+class ThreadPool;
+
+// Searched window of a node: the root, a PV node with an open window or a zero window node.
+// negamax and quiescence are instantiated per type and side to move so the checks fold away
+// at compile time.
+enum NodeType
+{
+   NonPV,
+   PV,
+   Root
+};
+
 struct SearchInfo
 {
    int32_t score = 0;
    uint8_t depth = 0;
    uint64_t nodes = 0;
    bool timeset = 0;
-   bool stopped = 0;
+   // Raised by the main thread (time, node limit) or the GUI, polled by every search thread
+   std::atomic<bool> stopped{false};
+   // Raises stopped at the hard deadline of a timed search and flags the soft one
+   DeadlineTimer timer;
    bool nodeset = 0;
+   // go infinite: keep the best move until the GUI sends stop
+   bool infinite = 0;
+   // go ponder: searching the opponent's expected move on our time, the best move
+   // is held back until ponderhit or stop and the clock only runs after ponderhit
+   std::atomic<bool> pondering{false};
+   // Number of best root moves reported, only the main thread searches more than one
+   int multiPV = 1;
+   // Set by the thread pool, reports count the nodes of every thread
+   const ThreadPool *pool = nullptr;
    bool uci = 0;
 };
 struct SearchStack
@@ -47,42 +85,127 @@ struct SearchStack
    HistoryTable *continuationHistory;
 };
 
+// One reported line: a root move, its score and the moves expected to follow
+struct PvLine
+{
+   int score = 0;
+   int length = 0;
+   Move moves[MAXPLY + 1];
+};
+
 // A struct to hold the search data
 struct SearchThread
 {
    SearchInfo &info;
+   // 0 is the main thread, it alone manages time and reports to the GUI
+   int id = 0;
    Board board;
    HistoryTable searchHistory;
    HistoryTable continuationHistory[13][64];
-   uint64_t nodes = 0;
+   PawnTable pawnTable;
+   NNUE::Net nnue;
+   // Written only by the thread that owns it, read by the main thread for reports
+   std::atomic<uint64_t> nodes{0};
+   // Deepest ply reached in the current iteration
+   int seldepth = 0;
+   // Prints info lines, only ever set on the main thread
+   bool reporting = false;
+   SearchStats stats;
    Move bestMove = NO_MOVE;
    TimeMan tm;
 
-   SearchThread(SearchInfo &i) : info(i), board(DEFAULT_POS)
+   // Result of the last fully searched depth
+   int completedDepth = 0;
+   int rootScore = 0;
+   Move rootMove = NO_MOVE;
+
+   // Triangular PV table, row ply holds the best line found from that ply on
+   Move pvTable[MAXPLY + 2][MAXPLY + 2];
+   int pvLength[MAXPLY + 2];
+
+   // MultiPV lines of the current iteration, best first. Root moves of the
+   // lines before pvIndex are skipped while line pvIndex is searched.
+   PvLine lines[MAXMULTIPV];
+   int pvIndex = 0;
+
+   // Nodes spent below each root move this search, indexed by from and to square
+   uint64_t rootMoveNodes[64][64];
+
+   SearchThread(SearchInfo &i, int threadId = 0) : info(i), id(threadId), board(DEFAULT_POS)
    {
       clear();
    }
 
+   /// @brief forget everything learned, for a new game
    inline void clear()
    {
-      nodes = 0;
+      newSearch();
 
       memset(searchHistory.data(), 0, sizeof(searchHistory));
       memset(continuationHistory, 0, sizeof(continuationHistory));
+   }
+
+   /// @brief resets the state of a single search, the histories carry over and are only aged
+   inline void newSearch()
+   {
+      nodes.store(0, std::memory_order_relaxed);
+      seldepth = 0;
+      stats.clear();
+      completedDepth = 0;
+      rootScore = 0;
+      rootMove = NO_MOVE;
+      bestMove = NO_MOVE;
+      pvIndex = 0;
+      memset(rootMoveNodes, 0, sizeof(rootMoveNodes));
+      for (PvLine &line : lines)
+      {
+         line.score = 0;
+         line.length = 0;
+      }
 
       tm.reset();
    }
 
+   /// @brief scales every history score down, so the ordering learned on earlier
+   /// moves of the game guides the next search without drowning out what it finds
+   void ageHistories();
+
    inline void initialize()
    {
-      tm.start_time = misc::tick();
+      board.refresh(nnue);
+   }
+
+   /// @brief a child at ply + 1 improved alpha, prefix its line with move
+   inline void updatePv(int ply, Move move)
+   {
+      pvTable[ply][ply] = move;
+      for (int next = ply + 1; next < pvLength[ply + 1]; next++)
+         pvTable[ply][next] = pvTable[ply + 1][next];
+      pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+   }
 
-      if (info.timeset)
+   /// @brief the root move already heads an earlier MultiPV line of this iteration
+   inline bool excludedAtRoot(Move move) const
+   {
+      for (int i = 0; i < pvIndex; i++)
       {
-         tm.set_time(board.sideToMove);
+         if (lines[i].length > 0 && lines[i].moves[0] == move)
+            return true;
       }
+      return false;
+   }
+
+   /// @brief counts a node, only ever called by the owning thread, so a plain
+   /// load and store is enough and costs the same as a non atomic increment
+   inline uint64_t countNode()
+   {
+      const uint64_t count = nodes.load(std::memory_order_relaxed) + 1;
+      nodes.store(count, std::memory_order_relaxed);
+      return count;
    }
 
+   inline uint64_t nodeCount() const { return nodes.load(std::memory_order_relaxed); }
+
    inline Time start_time()
    {
       return tm.start_time;
@@ -95,7 +218,7 @@ struct SearchThread
  
    inline bool stop_early()
    {
-      if (info.timeset && (tm.stop_search() || info.stopped))
+      if (info.stopped.load(std::memory_order_relaxed) || (id == 0 && info.timeset && info.timer.softExpired()))
       {
          return true;
       }
@@ -107,16 +230,102 @@ struct SearchThread
 
    void check_time()
    {
-      if ((info.timeset && tm.check_time()) || (info.nodeset && nodes >= info.nodes))
+      // Helpers run until the main thread tells them to stop, time is left to the timer
+      if (id != 0)
+         return;
+
+      if (info.nodeset && nodeCount() >= info.nodes)
       {
          info.stopped = true;
       }
    }
 };
 
+// Lazy SMP: every thread searches the same root with its own board, histories
+// and search stack. Only the transposition table (and eval cache) are shared.
+// Helper threads live as long as the pool and sleep between searches.
+class ThreadPool
+{
+ public:
+   ThreadPool(SearchInfo &i) : info(i)
+   {
+      info.pool = this;
+      resize(1);
+   }
+
+   ~ThreadPool()
+   {
+      stop();
+      stopHelpers();
+   }
+
+   /// @brief keeps the main thread and adds or removes helpers
+   void resize(int count);
+
+   /// @brief searches the main thread's position on every thread, prints the best move
+   void search(int maxDepth);
+
+   /// @brief runs search() on its own thread and returns immediately
+   void start(int maxDepth);
+
+   /// @brief blocks until a running search has printed its best move
+   void wait();
+
+   /// @brief asks a running search to finish and waits for its best move
+   void stop();
+
+   /// @brief the opponent played the move we pondered on, continue as a normal search
+   void ponderhit();
+
+   /// @brief forget everything learned in previous games
+   void clear();
+
+   /// @brief resizes the pawn table of every thread, including ones added later
+   void setPawnHash(int MB);
+
+   SearchThread &main() { return *threads[0]; }
+
+   uint64_t nodes() const;
+
+   /// @brief pruning statistics of the last search summed over every thread
+   SearchStats stats() const;
+
+   int size() const { return static_cast<int>(threads.size()); }
+
+ private:
+   /// @brief body of helper thread index, searches once for every generation after searched
+   void helperLoop(int index, uint64_t searched);
+
+   /// @brief one helper thread per SearchThread except the main one
+   void startHelpers();
+   void stopHelpers();
+
+   SearchInfo &info;
+   std::vector<std::unique_ptr<SearchThread>> threads;
+   std::vector<std::thread> helpers;
+   std::thread searcher;
+
+   // Wakes the helpers for a new search and tells the main thread when they are done
+   std::mutex helperMutex;
+   std::condition_variable helperWake;
+   std::condition_variable helpersDone;
+   // Bumped once per search, a helper searches when it sees a generation it has not searched
+   uint64_t generation = 0;
+   int helperDepth = 0;
+   int helpersRunning = 0;
+   bool helpersExit = false;
+
+   // Holds the best move of an infinite or ponder search until stop() or ponderhit()
+   std::mutex releaseMutex;
+   std::condition_variable released;
+   int pawnHashMB = DEFAULT_PAWNHASH;
+};
+
 // Global search stats object
 void initLateMoveTable();
+template <NodeType nodeType, Color c>
 int negamax(int alpha, int beta, int depth, SearchThread &st, SearchStack *ss, bool cutnode);
+template <NodeType nodeType, Color c>
 int quiescence(int alpha, int beta, SearchThread &st, SearchStack *ss);
 
 // Original non-templated function (kept for backward compatibility)
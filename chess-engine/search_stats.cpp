@@ -0,0 +1,83 @@
+#include "search_stats.hpp"
+
+#ifdef SEARCH_STATS
+
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+static const char *STAT_NAMES[STAT_COUNT] = {
+    "nodes",         "qnodes",         "tt probes pv",      "tt hits pv",      "tt probes nonpv",
+    "tt hits nonpv", "tt cutoffs",     "qs tt probes",      "qs tt hits",      "rfp",
+    "nmp tries",     "nmp cutoffs",    "probcut tries",     "probcut cutoffs", "razoring",
+    "lmp",           "history pruning", "futility",         "see quiet",       "see noisy",
+    "lmr searches",  "lmr researches", "beta cutoffs",      "first move cutoffs",
+};
+
+static double percent(uint64_t part, uint64_t whole) { return whole ? 100.0 * part / whole : 0.0; }
+
+void SearchStats::clear()
+{
+   std::memset(counters, 0, sizeof(counters));
+   std::memset(nodesAtDepth, 0, sizeof(nodesAtDepth));
+   std::memset(cutoffsAtDepth, 0, sizeof(cutoffsAtDepth));
+   std::memset(iterationNodes, 0, sizeof(iterationNodes));
+}
+
+void SearchStats::merge(const SearchStats &other)
+{
+   for (int i = 0; i < STAT_COUNT; i++)
+      counters[i] += other.counters[i];
+
+   for (int d = 0; d <= MAXDEPTH; d++)
+   {
+      nodesAtDepth[d] += other.nodesAtDepth[d];
+      cutoffsAtDepth[d] += other.cutoffsAtDepth[d];
+   }
+}
+
+std::string SearchStats::report() const
+{
+   std::ostringstream out;
+   out.setf(std::ios::fixed);
+   out.precision(1);
+
+   for (int i = 0; i < STAT_COUNT; i++)
+      out << "info string " << STAT_NAMES[i] << " " << counters[i] << "\n";
+
+   out << "info string tt hit rate pv " << percent(counters[STAT_TT_HITS_PV], counters[STAT_TT_PROBES_PV])
+       << "% nonpv " << percent(counters[STAT_TT_HITS_NONPV], counters[STAT_TT_PROBES_NONPV])
+       << "% qs " << percent(counters[STAT_QS_TT_HITS], counters[STAT_QS_TT_PROBES]) << "%\n";
+   out << "info string nmp fail rate "
+       << percent(counters[STAT_NMP_TRIES] - counters[STAT_NMP_CUTOFFS], counters[STAT_NMP_TRIES]) << "%\n";
+   out << "info string lmr research rate " << percent(counters[STAT_LMR_RESEARCHES], counters[STAT_LMR_SEARCHES])
+       << "%\n";
+   out << "info string first move cutoff rate "
+       << percent(counters[STAT_FIRST_MOVE_CUTOFFS], counters[STAT_BETA_CUTOFFS]) << "%\n";
+
+   // Effective branching factor: growth between the last two iterations and
+   // the geometric mean over the whole search
+   int last = 0;
+   for (int d = 1; d <= MAXDEPTH; d++)
+      if (iterationNodes[d])
+         last = d;
+
+   out.precision(2);
+   if (last > 1 && iterationNodes[last - 1])
+      out << "info string ebf last " << double(iterationNodes[last]) / iterationNodes[last - 1] << " mean "
+          << std::pow(double(iterationNodes[last]), 1.0 / last) << "\n";
+
+   for (int d = 1; d <= MAXDEPTH; d++)
+   {
+      if (!nodesAtDepth[d])
+         continue;
+      out << "info string depth " << d << " nodes " << nodesAtDepth[d] << " cutoffs " << cutoffsAtDepth[d] << "\n";
+   }
+
+   std::string text = out.str();
+   if (!text.empty())
+      text.pop_back();
+   return text;
+}
+
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "types.hpp"
+#include <cstdint>
+#include <string>
+
+// *******************
+// Search statistics
+// *******************
+
+// Counts what the pruning and reduction rules do. Only built with
+// `make STATS=1`, otherwise every call below is an empty inline function.
+
+enum Stat : uint8_t
+{
+   STAT_NODES,
+   STAT_QNODES,
+   STAT_TT_PROBES_PV,
+   STAT_TT_HITS_PV,
+   STAT_TT_PROBES_NONPV,
+   STAT_TT_HITS_NONPV,
+   STAT_TT_CUTOFFS,
+   STAT_QS_TT_PROBES,
+   STAT_QS_TT_HITS,
+   STAT_RFP,
+   STAT_NMP_TRIES,
+   STAT_NMP_CUTOFFS,
+   STAT_PROBCUT_TRIES,
+   STAT_PROBCUT_CUTOFFS,
+   STAT_RAZORING,
+   STAT_LMP,
+   STAT_HISTORY_PRUNING,
+   STAT_FUTILITY,
+   STAT_SEE_QUIET,
+   STAT_SEE_NOISY,
+   STAT_LMR_SEARCHES,
+   STAT_LMR_RESEARCHES,
+   STAT_BETA_CUTOFFS,
+   STAT_FIRST_MOVE_CUTOFFS,
+   STAT_COUNT
+};
+
+#ifdef SEARCH_STATS
+
+struct SearchStats
+{
+   static constexpr bool enabled = true;
+
+   uint64_t counters[STAT_COUNT];
+   // Histograms over the remaining depth of main search nodes
+   uint64_t nodesAtDepth[MAXDEPTH + 1];
+   uint64_t cutoffsAtDepth[MAXDEPTH + 1];
+   // Nodes searched when each iteration finished, for the branching factor
+   uint64_t iterationNodes[MAXDEPTH + 1];
+
+   SearchStats() { clear(); }
+
+   void add(Stat stat) { counters[stat]++; }
+
+   void node(int depth) { nodesAtDepth[std::min(depth, MAXDEPTH)]++; }
+
+   void cutoff(int depth, bool firstMove)
+   {
+      counters[STAT_BETA_CUTOFFS]++;
+      counters[STAT_FIRST_MOVE_CUTOFFS] += firstMove;
+      cutoffsAtDepth[std::min(depth, MAXDEPTH)]++;
+   }
+
+   void iteration(int depth, uint64_t nodes) { iterationNodes[std::min(depth, MAXDEPTH)] = nodes; }
+
+   void clear();
+
+   /// @brief adds the counters of another thread, keeps our own iteration history
+   void merge(const SearchStats &other);
+
+   /// @brief the whole report, one "info string" line per row
+   std::string report() const;
+};
+
+#else
+
+struct SearchStats
+{
+   static constexpr bool enabled = false;
+
+   void add(Stat) {}
+   void node(int) {}
+   void cutoff(int, bool) {}
+   void iteration(int, uint64_t) {}
+   void clear() {}
+   void merge(const SearchStats &) {}
+   std::string report() const { return "info string search statistics are off, rebuild with make STATS=1"; }
+};
+
+#endif
@@ -1,8 +1,17 @@
 #pragma once
 
 #include "types.hpp"
-#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
+#define DEFAULT_MOVE_OVERHEAD 10
+#define MAX_MOVE_OVERHEAD 5000
+
+// All times are integer microseconds (Time), the GUI's milliseconds are converted on input
 struct TimeMan {
     int movestogo = -1;
 
@@ -14,8 +23,11 @@ struct TimeMan {
 
     Time movetime = -1;
 
+    // Lost on every move between the GUI's clock and ours, UCI option "Move Overhead"
+    Time move_overhead = DEFAULT_MOVE_OVERHEAD * MILLISECOND;
+
+    // Set when the go command arrives, the GUI's clock is already running
     Time start_time{};
-    Time end_time{};
     Time stoptime_max{};
     Time stoptime_opt{};
     Time average_time{};
@@ -23,48 +35,58 @@ struct TimeMan {
     int stability{};
 
     Move prev_bestmove{NO_MOVE};
+    int prev_score{};
 
     void set_time(Color side) {
-        constexpr int safety_overhead = 50;
-        Time uci_time = (side == White ? wtime : btime);
-
-        if (movestogo != -1) {
-
-            uci_time -= safety_overhead;
+        // Sudden death games are planned as if this many moves were left
+        constexpr int default_movestogo = 25;
 
-            Time time_slot = average_time = uci_time / (double)movestogo;
-
-            stoptime_max = time_slot;
-            stoptime_opt = time_slot;
-        } else if (movetime == -1) {
-            Time inc = (side == White ? winc : binc);
-            uci_time -= safety_overhead;
-
-            uci_time /= 20;
+        if (movetime != -1) {
+            stoptime_max = stoptime_opt = average_time = std::max<Time>(movetime - move_overhead, MILLISECOND);
+            return;
+        }
 
-            Time time_slot = average_time = uci_time + inc;
-            Time basetime = (time_slot);
+        Time uci_time = (side == White ? wtime : btime);
+        Time inc = (side == White ? winc : binc);
+        int mtg = movestogo != -1 ? std::clamp(movestogo, 1, default_movestogo) : default_movestogo;
 
-            Time optime = basetime * 0.6;
+        // Every remaining move until the next time control pays the overhead
+        Time available = std::max<Time>(uci_time - move_overhead * mtg, MILLISECOND);
 
-            Time maxtime = std::min<Time>(uci_time, basetime * 2);
-            stoptime_max = maxtime;
-            stoptime_opt = optime;
+        average_time = std::min<Time>(available / mtg + inc * 3 / 4, available);
 
-        } else if (movetime != -1) {
-            movetime -= safety_overhead;
-            stoptime_max = stoptime_opt = average_time = movetime;
-        }
+        stoptime_max = std::min<Time>(average_time * 5, available * 4 / 5);
+        stoptime_opt = std::min<Time>(average_time * 3 / 5, stoptime_max);
     }
 
-    bool check_time() { return (misc::tick() > (start_time + stoptime_max)); }
-
-    bool stop_search() { return (misc::tick() > (start_time + stoptime_opt)); }
-
-    void update_tm(Move bestmove) {
-
-        // Stability scale from Stash
-        constexpr double stability_scale[5] = {2.50, 1.20, 0.90, 0.80, 0.75};
+    /// @brief rescales the soft limit after an iteration
+    /// @param bestmove the best move of the iteration
+    /// @param score its score
+    /// @param bestmove_nodes share of the search's nodes spent below bestmove, in per mille
+    void update_tm(Move bestmove, int score, int bestmove_nodes) {
+
+        // A fixed movetime is spent completely
+        if (movetime != -1)
+            return;
+
+        // Stability scale from Stash, in percent
+        constexpr int stability_scale[5] = {250, 120, 90, 80, 75};
+        // Centipawns the score has to fall per percent of extra time, and the largest drop counted
+        constexpr int drop_cp_per_percent = 2;
+        constexpr int max_drop_cp = 100;
+        // Percent spent when the best move took none and all of the nodes
+        constexpr int effort_max = 200;
+        constexpr int effort_min = 50;
+
+        // The soft limit is at most 2.5 * 2 * 1.5 * 3/5 = 4.5 average moves and never passes
+        // the hard limit of 5 average moves, so the timer thread bounds every move
+        static_assert(stability_scale[0] * effort_max * (100 + max_drop_cp / drop_cp_per_percent) * 3 / 5 <=
+                      5 * 100 * 100 * 100);
+
+        // Spend more when the score falls, up to 50% extra for a 100cp drop
+        const int drop = prev_bestmove == NO_MOVE ? 0 : std::clamp(prev_score - score, 0, max_drop_cp);
+        const Time drop_scale = 100 + drop / drop_cp_per_percent;
+        prev_score = score;
 
         if (prev_bestmove != bestmove) {
             prev_bestmove = bestmove;
@@ -73,13 +95,108 @@ struct TimeMan {
             stability = std::min(stability + 1, 4);
         }
 
-        double scale = stability_scale[stability];
+        // A best move that takes most of the effort is rarely overturned,
+        // 50% to 200% as its share of nodes goes from all to none
+        const Time effort_scale = effort_max - bestmove_nodes * (effort_max - effort_min) / 1000;
 
-        stoptime_opt = std::min<Time>(stoptime_max, average_time * scale);
+        Time scaled = average_time * stability_scale[stability] / 100;
+        scaled = scaled * effort_scale / 100 * drop_scale / 100;
+
+        stoptime_opt = std::min<Time>(stoptime_max, scaled * 3 / 5);
     }
 
     void reset() {
         stability = 0;
         prev_bestmove = NO_MOVE;
+        prev_score = 0;
+    }
+};
+
+/// @brief Sleeps until the deadlines of a timed search and raises flags when they pass,
+/// so the search itself never reads the clock. The soft limit only sets softExpired(),
+/// the hard limit raises the stop flag every search thread polls.
+/// While pondering the timer is paused, ponderhit() starts the clock.
+class DeadlineTimer {
+  public:
+    ~DeadlineTimer() { stop(); }
+
+    /// @brief arms both limits of tm, a previous timer is stopped first
+    /// @param paused wait for ponderhit() before the clock runs
+    void start(std::atomic<bool> &stopFlag, const TimeMan &tm, bool paused) {
+        stop();
+        softFlag = false;
+        quit = false;
+        this->paused = paused;
+        origin = tm.start_time;
+        softLimit = tm.stoptime_opt;
+        hardLimit = tm.stoptime_max;
+        worker = std::thread([this, &stopFlag] { run(stopFlag); });
+    }
+
+    /// @brief moves the soft limit, e.g. after the time manager rescaled it
+    void set_soft(Time soft) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            softLimit = soft;
+        }
+        wakeup.notify_one();
     }
-};
\ No newline at end of file
+
+    /// @brief the opponent played the expected move, our clock runs from now on
+    void ponderhit(Time now) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            origin = now;
+            paused = false;
+        }
+        wakeup.notify_one();
+    }
+
+    /// @brief disarms the timer without touching the flags
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wakeup.notify_one();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    bool softExpired() const { return softFlag.load(std::memory_order_relaxed); }
+
+  private:
+    void run(std::atomic<bool> &stopFlag) {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (!quit) {
+            if (paused) {
+                wakeup.wait(lock);
+                continue;
+            }
+
+            const Time now = misc::now();
+
+            if (now >= origin + hardLimit) {
+                stopFlag.store(true, std::memory_order_relaxed);
+                return;
+            }
+
+            // A soft limit moved back behind the clock expires on the spot
+            softFlag.store(now >= origin + softLimit, std::memory_order_relaxed);
+
+            const Time next = origin + (softFlag ? hardLimit : std::min(softLimit, hardLimit));
+            wakeup.wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::microseconds(next)));
+        }
+    }
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::atomic<bool> softFlag{false};
+    bool quit = false;
+    bool paused = false;
+    Time origin{};
+    Time softLimit{};
+    Time hardLimit{};
+};
@@ -1,36 +1,169 @@
 #include "tt.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#elif defined(_WIN32)
+#include <malloc.h>
+#endif
+
+// Transparent huge pages come in 2 MB, aligning the table to them lets
+// the kernel back it with large pages and saves TLB misses while probing
+constexpr size_t LARGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/// @brief allocates size bytes aligned to LARGE_PAGE_SIZE
+/// @param zeroed set when the memory is known to read as zero already
+/// @return nullptr on failure
+static void *allocateLarge(size_t size, bool &zeroed)
+{
+#if defined(__linux__)
+    // Anonymous mappings are zero filled on first touch, so a fresh table costs
+    // nothing until the search writes to it. Map one extra large page and trim
+    // the ends to get the alignment.
+    const size_t mapped = size + LARGE_PAGE_SIZE;
+    void *raw = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return nullptr;
+
+    const uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+    const uintptr_t aligned = (start + LARGE_PAGE_SIZE - 1) & ~(LARGE_PAGE_SIZE - 1);
+    if (aligned > start)
+        munmap(raw, aligned - start);
+    if (start + mapped > aligned + size)
+        munmap(reinterpret_cast<void *>(aligned + size), start + mapped - aligned - size);
+
+    madvise(reinterpret_cast<void *>(aligned), size, MADV_HUGEPAGE);
+    zeroed = true;
+    return reinterpret_cast<void *>(aligned);
+#elif defined(_WIN32)
+    zeroed = false;
+    return _aligned_malloc(size, LARGE_PAGE_SIZE);
+#else
+    zeroed = false;
+    return std::aligned_alloc(LARGE_PAGE_SIZE, size);
+#endif
+}
 
-void TranspositionTable::Initialize(int MB)
+static void freeLarge(void *mem, size_t size)
 {
+    if (!mem)
+        return;
+#if defined(__linux__)
+    munmap(mem, size);
+#elif defined(_WIN32)
+    (void)size;
+    _aligned_free(mem);
+#else
+    (void)size;
+    std::free(mem);
+#endif
+}
+
+void TranspositionTable::Initialize(int MB, int threadCount)
+{
+    currentAge = 0;
+
+    // Sizes are whole large pages, that is a whole number of clusters too
+    const size_t bytes = U64(MB) * 1024 * 1024 / LARGE_PAGE_SIZE * LARGE_PAGE_SIZE;
+
+    // Same size: keep the memory and only wipe it
+    if (clusters && clusterCount * sizeof(TTCluster) == bytes)
+    {
+        zero(threadCount);
+        return;
+    }
+
     clear();
-    this->entries.resize((MB * 1024 * 1024) / sizeof(TTEntry), TTEntry());
-    std::fill(entries.begin(), entries.end(), TTEntry());
 
-    // std::cout << "Transposition Table Initialized with " << entries.size() << " entries (" << MB << "MB)" << std::endl;
+    // Fall back to smaller tables rather than dying when the machine cannot provide the memory
+    size_t size = std::max(bytes, LARGE_PAGE_SIZE);
+    bool zeroed = false;
+    void *mem = nullptr;
+
+    while (!(mem = allocateLarge(size, zeroed)))
+    {
+        if (size <= LARGE_PAGE_SIZE)
+            throw std::bad_alloc();
+        size = std::max(size / 2 / LARGE_PAGE_SIZE * LARGE_PAGE_SIZE, LARGE_PAGE_SIZE);
+        std::cout << "info string hash allocation failed, retrying with " << size / (1024 * 1024) << " MB" << std::endl;
+    }
+
+    clusters = static_cast<TTCluster *>(mem);
+    clusterCount = size / sizeof(TTCluster);
+
+    if (!zeroed)
+        zero(threadCount);
 }
 
-void TranspositionTable::store(U64 key, uint8_t f, Move move, uint8_t depth, int score, int eval)
+void TranspositionTable::zero(int threadCount)
 {
-    TTEntry& entry = entries[reduce_hash(key, entries.size())];
+    // Small tables are not worth starting threads for
+    const size_t bytes = clusterCount * sizeof(TTCluster);
+    if (threadCount <= 1 || bytes < 64 * LARGE_PAGE_SIZE)
+    {
+        std::memset(static_cast<void *>(clusters), 0, bytes);
+        return;
+    }
 
-    bool replace = false;
+    std::vector<std::thread> workers;
+    const size_t chunk = clusterCount / threadCount;
 
-    replace = !entry.key || (entry.age != currentAge || entry.depth <= depth);
+    for (int i = 0; i < threadCount; i++)
+    {
+        const size_t begin = i * chunk;
+        const size_t count = i == threadCount - 1 ? clusterCount - begin : chunk;
+        workers.emplace_back([this, begin, count] {
+            std::memset(static_cast<void *>(clusters + begin), 0, count * sizeof(TTCluster));
+        });
+    }
 
-    if (!replace){
-        return;
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+void TranspositionTable::store(U64 key, uint8_t f, Move move, uint8_t depth, int score, int eval)
+{
+    TTCluster &cluster = clusterOf(key);
+    const TTKey key16 = static_cast<TTKey>(key);
+
+    // Same position first, then an empty slot, otherwise the entry that is
+    // shallowest once every search it has survived counts against it
+    TTEntry *replace = &cluster.entries[0];
+    int worst = INT32_MAX;
+
+    for (TTEntry &entry : cluster.entries)
+    {
+        if (entry.flag == HFNONE || entry.key == key16)
+        {
+            replace = &entry;
+            break;
+        }
+
+        const int value = entry.depth - 8 * ageDistance(entry);
+        if (value < worst)
+        {
+            worst = value;
+            replace = &entry;
+        }
     }
 
-    if (move || static_cast<TTKey>(key) != entry.key)
+    TTEntry &entry = *replace;
+    const bool samePosition = entry.flag != HFNONE && entry.key == key16;
+
+    // Keep the old move rather than forgetting it when this result has none
+    if (move || !samePosition)
     {
         entry.move = move;
     }
 
-    if (f == HFEXACT || static_cast<TTKey>(key) != entry.key || depth + 4 > entry.depth)
+    if (f == HFEXACT || !samePosition || depth + 4 > entry.depth || entry.age != currentAge)
     {
-        entry.key = static_cast<TTKey>(key);
+        entry.key = key16;
         entry.flag = f;
-        entry.move = move;
         entry.depth = depth;
         entry.score = (int16_t)score;
         entry.eval = (int16_t)eval;
@@ -38,31 +171,71 @@ void TranspositionTable::store(U64 key, uint8_t f, Move move, uint8_t depth, int
     }
 }
 
-TTEntry& TranspositionTable::probe_entry(U64 key, bool& ttHit)
+TTEntry TranspositionTable::probe_entry(U64 key, bool& ttHit)
 {
-    TTEntry& entry = entries[reduce_hash(key, entries.size())];
+    const TTCluster &cluster = clusterOf(key);
+    const TTKey key16 = static_cast<TTKey>(key);
 
-    ttHit = (static_cast<TTKey>(key) == entry.key);
+    for (const TTEntry &entry : cluster.entries)
+    {
+        if (entry.key == key16 && entry.flag != HFNONE)
+        {
+            ttHit = true;
+            return entry;
+        }
+    }
 
-    return entry;
+    ttHit = false;
+    return TTEntry();
 }
 
 Move TranspositionTable::probeMove(U64 key){
-    TTEntry& entry = entries[reduce_hash(key, entries.size())];
-
-    if (static_cast<TTKey>(key) == entry.key){
-        return entry.move;
-    }
-
-    return NO_MOVE;
+    bool ttHit = false;
+    return probe_entry(key, ttHit).move;
 }
 
 void TranspositionTable::prefetch_tt(const U64 key){
-    prefetch(&(entries[reduce_hash(key, entries.size())]));
+    prefetch(&clusterOf(key));
 }
 
 void TranspositionTable::clear()
 {
     currentAge = 0;
-    entries.clear();
-}
\ No newline at end of file
+    freeLarge(clusters, clusterCount * sizeof(TTCluster));
+    clusters = nullptr;
+    clusterCount = 0;
+}
+
+int TranspositionTable::hashfull() const
+{
+    const size_t samples = std::min<size_t>(1000, clusterCount);
+    if (!samples)
+        return 0;
+
+    size_t used = 0;
+    for (size_t i = 0; i < samples; i++)
+    {
+        for (const TTEntry &entry : clusters[i].entries)
+            used += entry.flag != HFNONE && entry.age == currentAge;
+    }
+
+    return static_cast<int>(used * 1000 / (samples * CLUSTER_SIZE));
+}
+
+void EvalCache::Initialize(int MB)
+{
+    // Round down to a power of two so the index is a plain mask
+    U64 size = 1;
+    while (size * 2 * sizeof(std::atomic<U64>) <= U64(MB) * 1024 * 1024)
+        size *= 2;
+
+    slots = std::make_unique<std::atomic<U64>[]>(size);
+    mask = size - 1;
+    clear();
+}
+
+void EvalCache::clear()
+{
+    for (U64 i = 0; i <= mask; i++)
+        slots[i].store(0, std::memory_order_relaxed);
+}
@@ -1,10 +1,17 @@
 #pragma once
 
 #include "types.hpp"
+#include <atomic>
+#include <memory>
 
-// 8192 MBS
-#define MAXHASH 8192
+// 128 GB
+#define MAXHASH 131072
 
+// Size of the shared static evaluation cache
+#define EVALCACHE_MB 2
+
+// Verification bits, taken from the bottom of the key while the cluster index
+// comes from the top, so the two never overlap below 2^48 clusters
 using TTKey = uint16_t;
 
 enum : uint8_t { HFNONE, HFBETA, HFALPHA, HFEXACT };
@@ -13,42 +20,112 @@ struct TTEntry {
     int16_t score = 0;
     int16_t eval = 0;
 
-    uint8_t flag : 2;
-    uint8_t age : 6;
+    uint8_t flag : 2 = HFNONE;
+    uint8_t age : 6 = 0;
 
     uint8_t depth = 0;
 
     Move move = NO_MOVE;
     TTKey key = 0;
 
-    int get_score(){
+    int get_score() const {
       return (int)score;
     }
 
-    int get_eval(){
+    int get_eval() const {
       return (int)eval;
     }
 };
 
+// Entries sharing one 64 byte cache line. A probe reads exactly one cluster,
+// a store replaces the least valuable entry of that cluster.
+constexpr int CLUSTER_SIZE = 6;
+
+struct alignas(64) TTCluster {
+    TTEntry entries[CLUSTER_SIZE];
+    char padding[64 - CLUSTER_SIZE * sizeof(TTEntry)];
+};
+
+static_assert(sizeof(TTCluster) == 64, "a cluster has to fill exactly one cache line");
+
+// Ages wrap around in the 6 bit age field
+constexpr int AGE_CYCLE = 64;
+
 class TranspositionTable {
   private:
-    std::vector<TTEntry> entries;
+    TTCluster *clusters = nullptr;
+    size_t clusterCount = 0;
+
+    TTCluster &clusterOf(U64 key) {
+      return clusters[reduce_hash(key, clusterCount)];
+    }
+
+    /// @brief how many searches ago the entry was written
+    int ageDistance(const TTEntry &entry) const {
+      return (AGE_CYCLE + currentAge - entry.age) % AGE_CYCLE;
+    }
+
+    /// @brief zeroes every cluster, an all zero entry is an empty one
+    void zero(int threadCount);
 
   public:
     uint8_t currentAge = 0;
 
-    void Initialize(int usersize);
+    TranspositionTable() = default;
+    TranspositionTable(const TranspositionTable &) = delete;
+    TranspositionTable &operator=(const TranspositionTable &) = delete;
+    ~TranspositionTable() { clear(); }
+
+    /// @brief (re)allocates the table, a table of the same size is only wiped
+    /// @param usersize size in MB
+    /// @param threadCount threads sharing the work of wiping the table
+    void Initialize(int usersize, int threadCount = 1);
     void store(U64 key, uint8_t f, Move move, uint8_t depth, int score, int eval);
-    TTEntry &probe_entry(U64 key, bool &ttHit);
+    TTEntry probe_entry(U64 key, bool &ttHit);
     Move probeMove(U64 key);
     void prefetch_tt(const U64 key);
+
+    /// @brief releases the memory
     void clear();
 
+    /// @brief permille of a sample of entries written by the current search
+    int hashfull() const;
+
     void nextAge(){
-      currentAge = std::min<uint8_t>(currentAge + 1, 63);
+      currentAge = (currentAge + 1) % AGE_CYCLE;
     }
 };
 
+// Lockless cache of static evaluations keyed by the full hash key.
+// Every slot packs the upper 48 key bits and the 16 bit score into one word,
+// so a racing write can never pair one position's key with another's score.
+class EvalCache {
+  private:
+    std::unique_ptr<std::atomic<U64>[]> slots;
+    U64 mask = 0;
+
+  public:
+    void Initialize(int MB);
+
+    bool probe(U64 key, int &eval) const
+    {
+        const U64 data = slots[key & mask].load(std::memory_order_relaxed);
+
+        if ((data ^ key) & ~U64(0xFFFF))
+            return false;
+
+        eval = static_cast<int16_t>(data & 0xFFFF);
+        return true;
+    }
+
+    void store(U64 key, int eval)
+    {
+        slots[key & mask].store((key & ~U64(0xFFFF)) | static_cast<uint16_t>(eval), std::memory_order_relaxed);
+    }
+
+    void clear();
+};
+
 static inline void prefetch(const void *addr) {
 #if defined(__INTEL_COMPILER) || defined(_MSC_VER)
     _mm_prefetch((char *)addr, _MM_HINT_T0);
@@ -31,11 +31,26 @@ constexpr int mated_in(int ply){
 
 #define IS_DEBUG true
 
-typedef double Time;
+// Microseconds, see misc::now()
+typedef int64_t Time;
+
+constexpr Time MILLISECOND = 1000;
 
 static inline bool is_capture(Board &board, Move move) { return (board.pieceAtB(to(move)) != None); }
 
-static inline uint32_t reduce_hash(uint32_t x, uint32_t N) { return ((uint64_t)x * (uint64_t)N) >> 32; }
+/// @brief maps a 64 bit hash onto [0, N) with the high half of x * N, so the index
+/// comes from the top bits of x and the low bits stay free for verification
+static inline uint64_t reduce_hash(uint64_t x, uint64_t N)
+{
+#if defined(__SIZEOF_INT128__)
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(x) * N) >> 64);
+#else
+    const uint64_t xLo = uint32_t(x), xHi = x >> 32;
+    const uint64_t nLo = uint32_t(N), nHi = N >> 32;
+    const uint64_t mid = xHi * nLo + ((xLo * nLo) >> 32);
+    return xHi * nHi + (mid >> 32) + ((xLo * nHi + uint32_t(mid)) >> 32);
+#endif
+}
 
 enum {
     NSQUARES = 64,
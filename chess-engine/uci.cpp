@@ -1,11 +1,19 @@
 #include "uci.hpp"
+#include "output.hpp"
 static void uci_send_id()
 {
-    std::cout << "id name " << NAME << std::endl;
-    std::cout << "id author " << AUTHOR << std::endl;
-    std::cout << "option name Hash type spin default 64 min 4 max " << MAXHASH << std::endl;
-    std::cout << "option name Threads type spin default 1 min 1 max 1" << std::endl;
-    std::cout << "uciok" << std::endl;
+    output.send(std::string("id name ") + NAME);
+    output.send(std::string("id author ") + AUTHOR);
+    output.send("option name Hash type spin default 64 min 4 max " + std::to_string(MAXHASH));
+    output.send("option name PawnHash type spin default " + std::to_string(DEFAULT_PAWNHASH) + " min 1 max " +
+                std::to_string(MAXPAWNHASH));
+    output.send("option name EvalFile type string default <empty>");
+    output.send("option name Threads type spin default 1 min 1 max " + std::to_string(MAXTHREADS));
+    output.send("option name MultiPV type spin default 1 min 1 max " + std::to_string(MAXMULTIPV));
+    output.send("option name Ponder type check default false");
+    output.send("option name Move Overhead type spin default " + std::to_string(DEFAULT_MOVE_OVERHEAD) + " min 0 max " +
+                std::to_string(MAX_MOVE_OVERHEAD));
+    output.send("uciok");
 }
 
 
@@ -13,18 +21,51 @@ int DefaultHashSize = 64;
 int CurrentHashSize = DefaultHashSize;
 int LastHashSize = CurrentHashSize;
 
+// Milliseconds lost per move between the GUI's clock and ours
+int MoveOverhead = DEFAULT_MOVE_OVERHEAD;
+
+// The GUI may send go ponder, otherwise it is searched as a normal go
+bool PonderEnabled = false;
+
 bool IsUci = false;
 
+// Positions of the bench command: openings, middlegames and endgames
+static const char *BENCH_FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "r2q1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 9",
+    "2rq1rk1/pb1nbppp/1p2pn2/2pp4/2PP4/1PNBPN2/PB3PPP/2RQ1RK1 w - - 0 12",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1",
+    "5rk1/1p3ppp/p2p4/3Pn3/1P2P3/P4B2/5PPP/2R3K1 b - - 0 25",
+};
+
 TranspositionTable *table;
+EvalCache *evalCache;
+
+// Commands that change the position, the options or the tables a running search uses.
+// The debug commands are listed too: the search plays its moves on the main thread's board.
+static bool interruptsSearch(const std::string &token)
+{
+    static const char *COMMANDS[] = {"position", "ucinewgame", "setoption", "go",         "bench",
+                                     "bencheval", "eval",      "print",     "repetition", "side"};
+    return std::find(std::begin(COMMANDS), std::end(COMMANDS), token) != std::end(COMMANDS);
+}
 
 void uci_loop()
 {
     SearchInfo info;
-    SearchThread searchThread(info);
-    searchThread.board = Board(DEFAULT_POS);
+    ThreadPool threads(info);
+    SearchThread &searchThread = threads.main();
     auto ttable = std::make_unique<TranspositionTable>();
     table = ttable.get();
     table->Initialize(DefaultHashSize);
+    auto ecache = std::make_unique<EvalCache>();
+    evalCache = ecache.get();
+    evalCache->Initialize(EVALCACHE_MB);
 
     // Create our board instance
     int default_depth = 15; // Default search depth
@@ -38,24 +79,39 @@ void uci_loop()
         token.clear();
         is >> std::skipws >> token;
 
+        // Read-only and unknown commands leave a running search alone
+        if (interruptsSearch(token))
+        {
+            threads.stop();
+            // The search's last lines come out before anything this command prints
+            output.flush();
+        }
+
         if (token == "stop")
         {
-            info.stopped = true;
+            threads.stop();
+        }
+        else if (token == "ponderhit")
+        {
+            threads.ponderhit();
         }
         else if (token == "quit")
         {
-            info.stopped = true;
+            threads.stop();
             break;
         }
         else if (token == "isready")
         {
 
-            std::cout << "readyok" << std::endl;
+            // Queued behind the search's info lines, so it never overtakes them
+            output.send("readyok");
             continue;
         }
         else if (token == "ucinewgame")
         {
-            table->Initialize(CurrentHashSize);
+            table->Initialize(CurrentHashSize, threads.size());
+            threads.clear();
+            evalCache->clear();
             searchThread.applyFen(DEFAULT_POS);
             continue;
         }
@@ -131,6 +187,15 @@ void uci_loop()
             
             uint64_t nodes = -1;
 
+            // Limits from the previous go must not leak into this one
+            searchThread.tm = TimeMan();
+            searchThread.tm.start_time = misc::now();
+            searchThread.tm.move_overhead = MoveOverhead * MILLISECOND;
+            info.timeset = false;
+            info.nodeset = false;
+            info.infinite = false;
+            bool ponder = false;
+
             while (token != "none")
             {
                 if (token == "infinite")
@@ -138,6 +203,12 @@ void uci_loop()
                     depth = -1;
                     break;
                 }
+                if (token == "ponder")
+                {
+                    ponder = true;
+                    is >> std::skipws >> token;
+                    continue;
+                }
                 if (token == "movestogo")
                 {
                     is >> std::skipws >> token;
@@ -159,14 +230,14 @@ void uci_loop()
                 if (token == "wtime")
                 {
                     is >> std::skipws >> token;
-                    searchThread.tm.wtime = std::stod(token);
+                    searchThread.tm.wtime = std::stoll(token) * MILLISECOND;
                     is >> std::skipws >> token;
                     continue;
                 }
                 if (token == "btime")
                 {
                     is >> std::skipws >> token;
-                    searchThread.tm.btime = std::stod(token);
+                    searchThread.tm.btime = std::stoll(token) * MILLISECOND;
                     is >> std::skipws >> token;
                     continue;
                 }
@@ -175,14 +246,14 @@ void uci_loop()
                 if (token == "winc")
                 {
                     is >> std::skipws >> token;
-                    searchThread.tm.winc = std::stod(token);
+                    searchThread.tm.winc = std::stoll(token) * MILLISECOND;
                     is >> std::skipws >> token;
                     continue;
                 }
                 if (token == "binc")
                 {
                     is >> std::skipws >> token;
-                    searchThread.tm.binc = std::stod(token);
+                    searchThread.tm.binc = std::stoll(token) * MILLISECOND;
                     is >> std::skipws >> token;
                     continue;
                 }
@@ -190,7 +261,7 @@ void uci_loop()
                 if (token == "movetime")
                 {
                     is >> std::skipws >> token;
-                    searchThread.tm.movetime = stod(token);
+                    searchThread.tm.movetime = std::stoll(token) * MILLISECOND;
                     is >> std::skipws >> token;
                     continue;
                 }
@@ -218,11 +289,17 @@ void uci_loop()
             if (depth == -1)
             {
                 info.depth = MAXPLY;
+                info.infinite = true;
             }
 
+            // The opponent's think time is only ended by ponderhit or stop, not by the default depth
+            info.pondering = ponder && PonderEnabled;
+            if (info.pondering && depth == default_depth)
+                info.depth = MAXPLY;
+
             info.stopped = false;
             info.uci = IsUci;
-            iterativeDeepening(searchThread, info.depth);
+            threads.start(info.depth);
 
         }else if (token == "setoption")
         {
@@ -234,12 +311,115 @@ void uci_loop()
                 {
                     is >> std::skipws >> token; // Skip "value"
                     is >> std::skipws >> token;
-                    CurrentHashSize = std::stoi(token);
-                    table->Initialize(CurrentHashSize);
+                    CurrentHashSize = std::clamp(std::stoi(token), 4, MAXHASH);
+                    table->Initialize(CurrentHashSize, threads.size());
+                }
+                else if (token == "EvalFile")
+                {
+                    is >> std::skipws >> token; // Skip "value"
+                    std::string path;
+                    std::getline(is >> std::ws, path);
+
+                    if (path.empty() || path == "<empty>")
+                    {
+                        NNUE::unload();
+                        output.send("info string using handcrafted evaluation");
+                    }
+                    else if (NNUE::load(path))
+                        output.send("info string loaded net " + path);
+                    else
+                        output.send("info string could not load net " + path);
+
+                    // Cached scores came from the previous evaluator
+                    evalCache->clear();
+                    table->Initialize(CurrentHashSize, threads.size());
+                }
+                else if (token == "PawnHash")
+                {
+                    is >> std::skipws >> token; // Skip "value"
+                    is >> std::skipws >> token;
+                    threads.setPawnHash(std::stoi(token));
+                }
+                else if (token == "Threads")
+                {
+                    is >> std::skipws >> token; // Skip "value"
+                    is >> std::skipws >> token;
+                    threads.resize(std::clamp(std::stoi(token), 1, MAXTHREADS));
+                }
+                else if (token == "MultiPV")
+                {
+                    is >> std::skipws >> token; // Skip "value"
+                    is >> std::skipws >> token;
+                    info.multiPV = std::clamp(std::stoi(token), 1, MAXMULTIPV);
+                }
+                else if (token == "Ponder")
+                {
+                    is >> std::skipws >> token; // Skip "value"
+                    is >> std::skipws >> token;
+                    PonderEnabled = token == "true";
+                }
+                else if (token == "Move")
+                {
+                    is >> std::skipws >> token; // Skip "Overhead"
+                    is >> std::skipws >> token; // Skip "value"
+                    is >> std::skipws >> token;
+                    MoveOverhead = std::clamp(std::stoi(token), 0, MAX_MOVE_OVERHEAD);
                 }
             }
         }
         /* Debugging Commands */
+        else if (token == "bench")
+        {
+            // Fixed depth searches from a fresh state, the node count is a signature of the search
+            int depth = 12;
+            if (is >> token)
+                depth = std::stoi(token);
+
+            table->Initialize(CurrentHashSize, threads.size());
+            threads.clear();
+            evalCache->clear();
+
+            info.timeset = false;
+            info.nodeset = false;
+            info.infinite = false;
+            info.pondering = false;
+            info.depth = depth;
+
+            uint64_t totalNodes = 0;
+            const Time start = misc::now();
+            for (const char *fen : BENCH_FENS)
+            {
+                searchThread.applyFen(fen);
+                searchThread.tm = TimeMan();
+                searchThread.tm.start_time = misc::now();
+                info.stopped = false;
+                threads.start(depth);
+                threads.wait();
+                totalNodes += threads.nodes();
+            }
+            const Time elapsed = std::max<Time>(1, misc::now() - start);
+            output.flush();
+
+            std::cout << "Nodes searched: " << totalNodes << std::endl;
+            std::cout << "Time (ms): " << elapsed / MILLISECOND << std::endl;
+            std::cout << "Nodes/second: " << totalNodes * 1000 * MILLISECOND / elapsed << std::endl;
+
+            searchThread.applyFen(DEFAULT_POS);
+            continue;
+        }
+        else if (token == "stats")
+        {
+            // The counters are only read once every search thread stopped writing them:
+            // a bounded search is waited for, one that only ends on stop is left alone
+            if ((info.infinite || info.pondering) && !info.stopped)
+            {
+                output.send("info string search running, send stop first");
+                continue;
+            }
+            threads.wait();
+            output.send(threads.stats().report());
+            continue;
+        }
         else if (token == "print")
         {
             std::cout << searchThread.board << std::endl;
@@ -254,7 +434,7 @@ void uci_loop()
             for (int i = 0; i < samples; i++)
             {
                 auto start = std::chrono::high_resolution_clock::now();
-                output = evaluate(searchThread.board);
+                output = evaluate(searchThread.board, searchThread.pawnTable);
                 auto stop = std::chrono::high_resolution_clock::now();
                 timeSum += std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
             }
@@ -266,7 +446,13 @@ void uci_loop()
         else if (token == "eval")
         {
 
-            std::cout << "Eval: " << evaluate(searchThread.board) << std::endl;
+            std::cout << "Eval: " << evaluate(searchThread.board, searchThread.pawnTable) << std::endl;
+
+            if (NNUE::isLoaded())
+            {
+                searchThread.board.refresh(searchThread.nnue);
+                std::cout << "NNUE: " << searchThread.nnue.evaluate(searchThread.board) << std::endl;
+            }
         }
         else if (token == "repetition")
         {
@@ -281,6 +467,13 @@ void uci_loop()
         
     }
 
+    // Input ended without quit: let a bounded search finish and report its move.
+    // Infinite and ponder searches only end on stop, which can no longer arrive.
+    if (!info.infinite && !info.pondering)
+        threads.wait();
+    threads.stop();
+    output.flush();
+
     table->clear();
 
     std::cout << std::endl;